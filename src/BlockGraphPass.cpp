@@ -1,45 +1,76 @@
 
+#include "Names.h"
+#include "TerminationLattice.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
-#include "llvm/Demangle/Demangle.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/PassInstrumentation.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/GraphWriter.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstdio>
-#include <unordered_map>
+#include <optional>
+#include <string>
 #include <vector>
 
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> graph_function(
+    "block-graph-function",
+    llvm::cl::desc("Function to render (mangled or demangled name)"),
+    llvm::cl::init("main"));
+
+static llvm::cl::opt<unsigned> collapse_threshold(
+    "block-graph-collapse-threshold",
+    llvm::cl::desc("In functions with more blocks than this, draw each "
+                   "outermost loop as a single node"),
+    llvm::cl::init(500));
+
 //------------------------------------------------------------------------------
 // New PM interface
 //------------------------------------------------------------------------------
 
-std::string friendly_name_block(llvm::StringRef unfriendly) {
-  llvm::StringRef tail = unfriendly;
-  llvm::StringRef head;
-  std::string result;
-  while (tail != "") {
-    auto spl = tail.split('.');
-    head = spl.first;
-    tail = spl.second;
-    result.append(llvm::demangle(head));
-    if (tail != "") {
-      result.push_back('.');
-    }
+const char *fill_color(std::optional<DoesThisTerminate> elt) {
+  switch (elt.value_or(DoesThisTerminate::Unevaluated)) {
+  case DoesThisTerminate::Unevaluated:
+    return "white";
+  case DoesThisTerminate::Bounded:
+    return "palegreen";
+  case DoesThisTerminate::Unbounded:
+    return "salmon";
+  case DoesThisTerminate::Unknown:
+    return "orange";
   }
-
-  return result;
+  return "white";
 }
 
+// A node of the graph: one block, or (when collapsed) a whole loop nest.
+// Built just before it's printed, so a large function is never held in
+// memory as a graph.
 struct Block {
-  std::string name;
+  // Points into the name cache.
+  llvm::StringRef name;
   size_t instruction_count;
-  int id;
-  bool is_external;
+  uint32_t id;
   bool is_entry;
+  std::optional<DoesThisTerminate> elt;
+  // Maximum trip count of the loop this heads; 0 if none, or not constant.
+  unsigned trip_bound;
+  // Number of blocks, if this is a collapsed loop nest; 0 otherwise.
+  size_t collapsed_blocks;
 
   void print(llvm::raw_ostream &os) const {
     os << id << ": \t" << instruction_count << "i\t "
@@ -47,13 +78,22 @@ struct Block {
   }
 
   void print_node(llvm::raw_ostream &os) const {
-    os << "  block_" << id << "[";
+    os << "block_" << id << "[";
     // Properties:
-    os << "label=\"" << name << "\""
+    os << "label=\"" << llvm::DOT::EscapeString(name.str()) << "\\n";
+    if (collapsed_blocks != 0) {
+      os << collapsed_blocks << " blocks, ";
+    }
+    os << instruction_count << "i";
+    if (trip_bound != 0) {
+      os << ", <= " << trip_bound << " trips";
+    }
+    os << "\""
        << ",";
+    os << "style=filled,fillcolor=" << fill_color(elt) << ",";
     os << "shape=";
-    if (is_external) {
-      os << "rect";
+    if (collapsed_blocks != 0) {
+      os << "box3d";
     } else if (is_entry) {
       os << "doublecircle";
     } else {
@@ -62,24 +102,54 @@ struct Block {
     os << "]";
   }
 
-  static Block from_llvm(int *counter, bool external,
-                         const llvm::BasicBlock &block) {
-    auto id = *counter;
-    counter++;
-    auto friendly = friendly_name_block(block.getName());
+  static Block from_llvm(uint32_t id, const llvm::BasicBlock &block,
+                         const llvm::LoopInfo &LI, llvm::ScalarEvolution &SE) {
+    unsigned trip_bound = 0;
+    if (const llvm::Loop *loop = LI.getLoopFor(&block);
+        loop != nullptr && loop->getHeader() == &block) {
+      trip_bound = SE.getSmallConstantMaxTripCount(loop);
+    }
     return Block{
-        .name = friendly,
+        .name = friendly_name(block.getName()),
         .instruction_count = block.size(),
         .id = id,
-        .is_external = external,
         .is_entry = block.isEntryBlock(),
+        .elt = block_verdict(block),
+        .trip_bound = trip_bound,
+        .collapsed_blocks = 0,
     };
   }
+
+  // The nest under `loop`, named for (and with the id of) its header;
+  // its verdict is the join over all of its blocks.
+  static Block from_loop(uint32_t id, const llvm::Loop &loop,
+                         const llvm::LoopInfo &LI, llvm::ScalarEvolution &SE) {
+    Block result = from_llvm(id, *loop.getHeader(), LI, SE);
+    result.instruction_count = 0;
+    result.collapsed_blocks = loop.getNumBlocks();
+    for (const llvm::BasicBlock *block : loop.blocks()) {
+      result.instruction_count += block->size();
+      if (auto elt = block_verdict(*block)) {
+        result.elt = TerminationLattice::join(
+            result.elt.value_or(DoesThisTerminate::Unevaluated), *elt);
+      }
+    }
+    return result;
+  }
 };
 
+// Dense ids for the blocks (in function order), and the blocks that sit
+// directly in each loop rather than in one of its subloops.
+// The graph itself is streamed out by the printer.
 struct BlockGraphResult {
-  std::vector<Block> blocks;
-  std::vector<std::pair<int, int>> edges;
+  llvm::DenseMap<const llvm::BasicBlock *, uint32_t> ids;
+  llvm::DenseMap<const llvm::Loop *,
+                 llvm::SmallVector<const llvm::BasicBlock *, 4>>
+      members;
+
+  // Both are keyed by what LoopAnalysis saw, so go when it does.
+  bool invalidate(llvm::Function &F, const llvm::PreservedAnalyses &PA,
+                  llvm::FunctionAnalysisManager::Invalidator &Inv);
 };
 
 struct BlockGraphPass : public llvm::AnalysisInfoMixin<BlockGraphPass> {
@@ -109,79 +179,119 @@ public:
   static bool isRequired() { return true; }
 
 private:
+  // Each loop as a cluster, holding its blocks and its subloops' clusters.
+  void print_loop(const llvm::Loop &loop, const BlockGraphResult &graph,
+                  const llvm::LoopInfo &LI, llvm::ScalarEvolution &SE,
+                  unsigned depth);
+
   llvm::raw_ostream &OS;
 };
 
 llvm::AnalysisKey BlockGraphPass::Key;
 
+bool BlockGraphResult::invalidate(
+    llvm::Function &F, const llvm::PreservedAnalyses &PA,
+    llvm::FunctionAnalysisManager::Invalidator &Inv) {
+  auto checker = PA.getChecker<BlockGraphPass>();
+  return !(checker.preserved() ||
+           checker.preservedSet<llvm::AllAnalysesOn<llvm::Function>>()) ||
+         Inv.invalidate<llvm::LoopAnalysis>(F, PA);
+}
+
 BlockGraphPass::Result BlockGraphPass::run(llvm::Function &F,
-                                           llvm::FunctionAnalysisManager &) {
-  std::unordered_map<const llvm::BasicBlock *, Block> blocks;
-  int block_id = 0;
+                                           llvm::FunctionAnalysisManager &FAM) {
+  const auto &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+  BlockGraphPass::Result result;
+  uint32_t block_id = 0;
   for (const auto &block : F) {
-    auto friendly = friendly_name_block(block.getName());
-    blocks.insert(
-        {&block, Block::from_llvm(&block_id, /*external=*/false, block)});
-    block_id++;
+    result.ids[&block] = block_id++;
+    result.members[LI.getLoopFor(&block)].push_back(&block);
   }
+  return result;
+}
 
-  std::vector<std::pair<int, int>> edges;
-  for (const auto &block : F) {
-    for (const llvm::BasicBlock *successor : llvm::successors(&block)) {
-      auto successor_it = blocks.find(successor);
-      if (successor_it == blocks.end()) {
-        auto result = blocks.insert(
-            {&block,
-             Block::from_llvm(&block_id, /*external=*/true, *successor)});
-        successor_it = result.first;
-      }
-      const auto &block_info = blocks.at(&block);
-      edges.push_back({block_info.id, successor_it->second.id});
+void BlockGraphPrinter::print_loop(const llvm::Loop &loop,
+                                   const BlockGraphResult &graph,
+                                   const llvm::LoopInfo &LI,
+                                   llvm::ScalarEvolution &SE, unsigned depth) {
+  const std::string indent(2 * depth, ' ');
+  const uint32_t header = graph.ids.lookup(loop.getHeader());
+  OS << indent << "subgraph cluster_loop_" << header << " {\n";
+  OS << indent << "  label=\"\"\n";
+  if (auto it = graph.members.find(&loop); it != graph.members.end()) {
+    for (const llvm::BasicBlock *block : it->second) {
+      OS << indent << "  ";
+      Block::from_llvm(graph.ids.lookup(block), *block, LI, SE).print_node(OS);
+      OS << "\n";
     }
   }
-
-  std::vector<Block> out_blocks;
-  out_blocks.resize(blocks.size());
-  for (auto &&[_, block] : blocks) {
-    out_blocks[block.id] = std::move(block);
+  for (const llvm::Loop *subloop : loop) {
+    print_loop(*subloop, graph, LI, SE, depth + 1);
   }
-
-  return BlockGraphPass::Result{
-      .blocks = out_blocks,
-      .edges = edges,
-  };
+  OS << indent << "}\n";
 }
 
 llvm::PreservedAnalyses
 BlockGraphPrinter::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
-  const static std::string MY_NAME = "BlockGraphPrinter::run(llvm::Function&, "
-                                     "llvm::AnalysisManager<llvm::Function>&)";
-  const static std::string PASS_NAME =
-      "BlockGraphPass::run(llvm::Function&, "
-      "llvm::AnalysisManager<llvm::Function>&)";
-
-  auto demangled_fn = demangle(F.getName());
-  if (demangled_fn == "main") {
-    BlockGraphPass::Result &result = FAM.getResult<BlockGraphPass>(F);
-
-    // TODO: This is almost certainly redundant with a pass that uses
-    // https://llvm.org/doxygen/GraphWriter_8h_source.html
-
-    OS << "digraph {\n  label=\"" << demangle(F.getName()) << "\"\n\n";
-    for (const auto &block : result.blocks) {
-      block.print_node(OS);
+  if (F.isDeclaration() || (F.getName() != graph_function &&
+                            demangled_name(F.getName()) != graph_function)) {
+    return llvm::PreservedAnalyses::all();
+  }
+  const BlockGraphPass::Result &graph = FAM.getResult<BlockGraphPass>(F);
+  const auto &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+  auto &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+  const bool collapse = F.size() > collapse_threshold;
+
+  OS << "digraph {\n  label=\""
+     << llvm::DOT::EscapeString(demangled_name(F.getName()).str()) << "\"\n\n";
+  if (auto it = graph.members.find(nullptr); it != graph.members.end()) {
+    for (const llvm::BasicBlock *block : it->second) {
+      OS << "  ";
+      Block::from_llvm(graph.ids.lookup(block), *block, LI, SE).print_node(OS);
+      OS << "\n";
+    }
+  }
+  for (const llvm::Loop *loop : LI) {
+    if (collapse) {
+      OS << "  ";
+      Block::from_loop(graph.ids.lookup(loop->getHeader()), *loop, LI, SE)
+          .print_node(OS);
       OS << "\n";
+    } else {
+      print_loop(*loop, graph, LI, SE, 1);
+    }
+  }
+
+  // When collapsed, a block in a loop stands in for the loop's header,
+  // and edges within (or repeated between) loop nests are dropped.
+  auto node_of = [&](const llvm::BasicBlock *block) {
+    const llvm::Loop *loop = collapse ? LI.getLoopFor(block) : nullptr;
+    if (loop == nullptr) {
+      return graph.ids.lookup(block);
+    }
+    while (loop->getParentLoop() != nullptr) {
+      loop = loop->getParentLoop();
     }
-    OS << "// Edges: \n";
-    for (const auto &[out, in] : result.edges) {
+    return graph.ids.lookup(loop->getHeader());
+  };
+  llvm::DenseSet<std::pair<uint32_t, uint32_t>> seen;
+  OS << "// Edges: \n";
+  for (const auto &block : F) {
+    const uint32_t out = node_of(&block);
+    for (const llvm::BasicBlock *successor : llvm::successors(&block)) {
+      const uint32_t in = node_of(successor);
+      if (collapse && (LI.getLoopFor(&block) != nullptr ||
+                       LI.getLoopFor(successor) != nullptr) &&
+          (out == in || !seen.insert({out, in}).second)) {
+        continue;
+      }
       OS << "  "
          << "block_" << out << " -> "
          << "block_" << in << ";\n";
     }
-
-    OS << "} // end digraph\n";
   }
 
+  OS << "} // end digraph\n";
   return llvm::PreservedAnalyses::all();
 }
 
@@ -210,4 +320,4 @@ llvm::PassPluginLibraryInfo getBlockGraphPassPluginInfo() {
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
 llvmGetPassPluginInfo() {
   return getBlockGraphPassPluginInfo();
-}
\ No newline at end of file
+}
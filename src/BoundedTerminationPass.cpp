@@ -1,67 +1,198 @@
 
+#include "CallGraphPlanes.h"
+#include "Names.h"
+#include "SCCLoopPass.h"
+#include "TerminationLattice.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/ScalarEvolution.h"
-#include "llvm/Demangle/Demangle.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/PassInstrumentation.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/Pass.h"
+#include "llvm/Remarks/RemarkStreamer.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
 #include <algorithm>
+#include <array>
 #include <map>
+#include <optional>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 //------------------------------------------------------------------------------
 // Type definitions
 //------------------------------------------------------------------------------
 
-// Key result for the bounded termination pass:
-// Does this X terminate / do we know?
-enum class DoesThisTerminate {
-  // We haven't evaluated this X yet.
-  // Bottom of the lattice.
-  Unevaluated,
-
-  // Definitely terminates in a statically-bounded amount of time.
-  // We assume:
-  // - All memory operations (load/store) complete;
-  //   though this may not be true in all systems (embedded),
-  //   we consider using such transactions in an unbounded context undefined.
-  Bounded,
+// A loop that only exits once it wins a race with another thread:
+// bounded without contention, unbounded under it.
+struct ContendedLoop {
+  enum class Kind {
+    // Retries a compare-and-swap until it succeeds.
+    CompareExchangeRetry,
+    // Waits for an atomic or volatile location to change,
+    // e.g. a test-and-set lock acquisition.
+    SpinWait,
+  };
+  Kind kind;
+  // Header block of the loop.
+  const llvm::BasicBlock *header;
+  // The memory being fought over, and where.
+  std::string location;
+};
 
-  // The analyzer believes this will not terminate in bounded time:
-  // It diverges, or may extend indefinitely.
-  // For instance, it may read from stdin and wait for a newline-
-  // which may come arbitrarily far in the future, or may never appear.
-  // Or it may attempt to acquire a lock, which may never be released,
-  // or may take arbitrarily long.
-  //
-  // In the current implementation, we assume these things have unbounded
-  // latency:
-  // - System calls
-  // - Some loops (see "unknown")
-  Unbounded,
-
-  // The analyzer cannot reason about this X.
-  // This may be because the path is data-flow dependent,
-  // or because the analyzer does not have the reasoning to
-  // bound the flow.
-  //
-  //   TODO: Use annotations to say "assume yes/no" for a
-  //   function/block/call/etc
-  Unknown,
+// A loop with no bound of its own, whose exit test depends only on constants
+// and the function's arguments, e.g. `for (i = 0; i != n; i += step)`.
+// Callers that pass constants can work out whether it exits.
+struct ArgumentBoundedLoop {
+  const llvm::BasicBlock *header;
+  // The block whose test bounds the loop.
+  const llvm::BasicBlock *exiting;
+  // Numbers of the arguments the test depends on.
+  llvm::SmallVector<unsigned, 2> arguments;
+};
+
+// How deep a recursive group of functions can go: each call within the group
+// moves one argument (the "measure") one step closer to a value where the
+// group stops calling itself.
+struct RecursionBound {
+  // Number of the measure argument.
+  unsigned argument;
+  // Worst-case number of group frames on the stack at once.
+  uint64_t depth;
+  // `depth` times the largest frame's allocas; a lower bound on the stack.
+  uint64_t stack_bytes;
+  // Whether `depth` only holds for the calls in this module.
+  bool from_module_calls;
+};
+
+// What a profile (`!prof` metadata) says about one loop.
+struct LoopProfile {
+  // Header block of the loop.
+  const llvm::BasicBlock *header;
+  DoesThisTerminate elt;
+  // Times the header ran.
+  uint64_t header_count;
+  // Average iterations each time the loop is entered, if known.
+  std::optional<unsigned> trip_count;
+};
+
+// Worst-case stack use from a call to a function: its frame, plus the
+// deepest path of calls beneath it.
+struct StackBound {
+  // Bytes of fixed-size allocas on that path, with each recursive group at
+  // its worst-case depth. Spills and return addresses aren't counted, so this
+  // is a lower bound on the real stack.
+  uint64_t bytes = 0;
+  // If there's no bound, why not: recursion we can't bound, or an alloca
+  // whose size isn't fixed.
+  std::string unbounded;
+  // Whether some path calls code we can't see, which isn't counted.
+  bool calls_unknown = false;
+  // The functions called along the deepest path, outermost first.
+  std::vector<const llvm::Function *> path;
+};
+
+// Estimated worst-case cycles for a call to a function: each instruction's
+// cost on the target, times the trip bounds of the loops around it, along
+// the longest path, with the calls on it included.
+struct CycleCost {
+  // MaxCostLattice::kUnbounded if there's no bound.
+  uint64_t cycles = 0;
+  // If there's no bound, why not.
+  std::string unbounded;
+  // For functions with exception handling: along the paths that return
+  // normally, and from a landing pad on (if it has any).
+  std::optional<uint64_t> normal;
+  std::optional<uint64_t> unwind;
+  // Whether some path calls code we can't see, which only costs the call.
+  bool calls_unknown = false;
+};
+
+// Runtime calls with long or unpredictable latency, that a critical section
+// may want none of.
+enum class SlowCallKind : uint8_t {
+  Allocation,
+  Lock,
+  Logging,
+  IO,
+};
+constexpr size_t kSlowCallKinds = 4;
+
+// Worst-case numbers of slow calls for a call to a function, by kind, along
+// any path from it, with loops at their trip bounds.
+struct SlowCalls {
+  struct Count {
+    // MaxCostLattice::kUnbounded if there's no bound.
+    uint64_t calls = 0;
+    // If there's no bound, why not.
+    std::string unbounded;
+    // One of the functions counted, for the report.
+    const llvm::Function *example = nullptr;
+  };
+  std::array<Count, kSlowCallKinds> kinds;
+
+  bool any() const {
+    return llvm::any_of(kinds, [](const Count &count) {
+      return count.calls != 0;
+    });
+  }
+};
+
+// The verdict along one kind of path through a function.
+struct PathResult {
+  DoesThisTerminate elt;
+  std::string explanation;
 };
 
 // Complete result for a termination evaluation:
@@ -75,12 +206,62 @@ enum class DoesThisTerminate {
 struct TerminationPassResult {
   DoesThisTerminate elt = DoesThisTerminate::Unevaluated;
   std::string explanation = "unevaluated";
+  // Loops in this function (not its callees) that are only as bounded as
+  // the contention on some location.
+  std::vector<ContendedLoop> contended_loops;
+  // Loops in this function that are only as bounded as its arguments.
+  std::vector<ArgumentBoundedLoop> argument_bounded_loops;
+  // If this function is recursive, how far.
+  std::optional<RecursionBound> recursion;
+  // For functions with exception handling: the verdicts along the paths that
+  // return normally, and along the paths from a landing pad on (if it has
+  // any). -bounded-termination-unwind says which of them `elt` covers.
+  std::optional<PathResult> normal_path;
+  std::optional<PathResult> unwind_path;
+  // Worst-case stack use, for roots and must-be-bounded functions.
+  std::optional<StackBound> stack;
+  // Estimated worst-case cycles, with -bounded-termination-cycles.
+  std::optional<CycleCost> cycles;
+  // Slow runtime calls, for roots and must-be-bounded functions that make
+  // any.
+  std::optional<SlowCalls> slow_calls;
+  // Times this function was entered, if it has a profile.
+  std::optional<uint64_t> entry_count;
+  // Loops that matter, if it has a profile: those that aren't Bounded, and
+  // those that go around more than -bounded-termination-trip-threshold times.
+  std::vector<LoopProfile> loop_profiles;
+  // The verdict for each block, in function order.
+  std::vector<DoesThisTerminate> block_elts;
+};
+
+// A function (or instantiation of one) that isn't Bounded on its own
+// account, and the functions whose explanations lead back to it.
+struct RootCause {
+  std::string name;
+  DoesThisTerminate elt;
+  std::string explanation;
+  // Functions charged to it, not counting itself.
+  size_t poisoned = 0;
+  // Of those (and itself), the ones annotated must-be-bounded.
+  size_t must_be_bounded = 0;
 };
 
 // Results from analyzing the full module,
 // including call-graph analysis.
 struct ModuleTerminationPassResult {
   std::map<const llvm::Function *, TerminationPassResult> per_function_results;
+  // Functions annotated must-be-bounded that aren't.
+  std::vector<const llvm::Function *> must_be_bounded_violations;
+  // Functions annotated must-be-bounded that may make a slow call of a kind
+  // in -bounded-termination-ban.
+  std::vector<const llvm::Function *> banned_calls;
+  // Roots and must-be-bounded functions: the ones held to
+  // -bounded-termination-stack-limit and -bounded-termination-cycle-limit.
+  std::vector<const llvm::Function *> limited;
+  // Most poisoned first.
+  std::vector<RootCause> root_causes;
+  // Functions only called from assume-* functions, which we didn't analyze.
+  size_t skipped = 0;
 
   // Invalidated when:
   // - FunctionTerminationPass is invalidated
@@ -92,16 +273,215 @@ struct ModuleTerminationPassResult {
   }
 };
 
+// Functions annotated in the source, e.g.
+//   __attribute__((annotate("assume-bounded"))) void vendor_flush();
+// read from @llvm.global.annotations.
+struct TerminationAnnotations {
+  // Vetted by hand: take the verdict as given, and don't analyze the function
+  // (or anything only it calls).
+  llvm::DenseSet<const llvm::Function *> assume_bounded;
+  llvm::DenseSet<const llvm::Function *> assume_unbounded;
+  // It's an error if these aren't Bounded.
+  llvm::DenseSet<const llvm::Function *> must_be_bounded;
+
+  bool is_assumed(const llvm::Function *F) const {
+    return assume_bounded.contains(F) || assume_unbounded.contains(F);
+  }
+};
+
+struct TerminationAnnotationsAnalysis
+    : public llvm::AnalysisInfoMixin<TerminationAnnotationsAnalysis> {
+  using Result = TerminationAnnotations;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<TerminationAnnotationsAnalysis>;
+};
+
+// Where an indirect call may go.
+//
+// Candidates are grouped into sets, numbered densely; every call site that
+// resolves to the same set shares one node in the call graph, so a dispatch
+// table called from many places is only joined over once.
+struct IndirectCallTargets {
+  // The candidates in each set.
+  std::vector<std::vector<const llvm::Function *>> sets;
+  // Set numbers, by the key that selects them:
+  // - a `!callees` list on the call,
+  // - the type identifier of an `llvm.type.test` on the called pointer,
+  // - the called function type: any address-taken function of that type,
+  //   if the module is the whole program (-bounded-termination-whole-program).
+  llvm::DenseMap<const llvm::MDNode *, uint32_t> by_callees;
+  llvm::DenseMap<const llvm::Metadata *, uint32_t> by_type_id;
+  llvm::DenseMap<const llvm::FunctionType *, uint32_t> by_signature;
+
+  // The candidate set for an indirect call, if we have one.
+  std::optional<uint32_t> lookup(const llvm::CallBase &call) const;
+};
+
+struct IndirectCallTargetsAnalysis
+    : public llvm::AnalysisInfoMixin<IndirectCallTargetsAnalysis> {
+  using Result = IndirectCallTargets;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<IndirectCallTargetsAnalysis>;
+};
+
+// Recursion bounds for each recursive group (cyclic call-graph SCC) in the
+// module, computed once per group.
+struct RecursionBounds {
+  // Null if we couldn't bound the group.
+  std::vector<std::optional<RecursionBound>> sccs;
+  llvm::DenseMap<const llvm::Function *, uint32_t> scc_of;
+
+  const std::optional<RecursionBound> *lookup(const llvm::Function *F) const {
+    auto it = scc_of.find(F);
+    return it == scc_of.end() ? nullptr : &sccs[it->second];
+  }
+};
+
+struct RecursionBoundsAnalysis
+    : public llvm::AnalysisInfoMixin<RecursionBoundsAnalysis> {
+  using Result = RecursionBounds;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<RecursionBoundsAnalysis>;
+};
+
+// The SCCs of the call graph ("groups"), and the calls between them,
+// including the candidates of indirect calls: what the analyses that add
+// something up along call paths have in common.
+struct CallGroups {
+  struct Group {
+    std::vector<const llvm::Function *> members;
+    // A cycle of direct calls.
+    bool recursive = false;
+    // Whether some member calls code we can't see: a declaration, or an
+    // indirect call we have no candidates for.
+    bool calls_unknown = false;
+  };
+
+  std::vector<Group> groups;
+  llvm::DenseMap<const llvm::Function *, uint32_t> group_of;
+  DenseGraph calls = DenseGraph(0);
+  // Functions with bodies that nothing in the module calls: where the
+  // program (or an interrupt, or a thread) starts.
+  std::vector<const llvm::Function *> roots;
+  // Groups in depth-first post-order over `calls`, so callees come before
+  // their callers, and each group's place in it. The groups are the SCCs of
+  // the direct calls, so a call to a group at or after the caller's place
+  // goes back around a cycle through an indirect call.
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> position;
+};
+
+struct CallGroupsAnalysis
+    : public llvm::AnalysisInfoMixin<CallGroupsAnalysis> {
+  using Result = CallGroups;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<CallGroupsAnalysis>;
+};
+
+// Stack bounds for every function, over the call groups, computed once per
+// group.
+struct StackBounds {
+  struct Group {
+    uint64_t bytes = 0;
+    std::string unbounded;
+    bool calls_unknown = false;
+    // The group called on the deepest path, or kNoGroup.
+    uint32_t deepest = kNoGroup;
+  };
+  static constexpr uint32_t kNoGroup = ~0u;
+
+  // Indexed like CallGroups::groups.
+  std::vector<Group> groups;
+
+  StackBound lookup(const CallGroups &call_groups,
+                    const llvm::Function *F) const;
+};
+
+struct StackBoundsAnalysis
+    : public llvm::AnalysisInfoMixin<StackBoundsAnalysis> {
+  using Result = StackBounds;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<StackBoundsAnalysis>;
+};
+
+// Estimated worst-case cycles for every function with a body, callees
+// included; see -bounded-termination-cycles.
+struct CycleCosts {
+  llvm::DenseMap<const llvm::Function *, CycleCost> functions;
+};
+
+struct CycleCostsAnalysis
+    : public llvm::AnalysisInfoMixin<CycleCostsAnalysis> {
+  using Result = CycleCosts;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<CycleCostsAnalysis>;
+};
+
+// Slow calls for every function that may make any; see SlowCallKind.
+struct SlowCallCounts {
+  llvm::DenseMap<const llvm::Function *, SlowCalls> functions;
+};
+
+struct SlowCallsAnalysis
+    : public llvm::AnalysisInfoMixin<SlowCallsAnalysis> {
+  using Result = SlowCallCounts;
+  Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &);
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  static llvm::AnalysisKey Key;
+  friend llvm::AnalysisInfoMixin<SlowCallsAnalysis>;
+};
+
 // Pass over functions: does this terminate:
 struct FunctionTerminationPass
     : public llvm::AnalysisInfoMixin<FunctionTerminationPass> {
   using Result = TerminationPassResult;
+  // Results carried over from an earlier parse of the same code, to return
+  // rather than recompute; see serve<bounded-termination>.
+  using Carried = llvm::DenseMap<const llvm::Function *, TerminationPassResult>;
+
+  explicit FunctionTerminationPass(const Carried *carried = nullptr)
+      : carried(carried) {}
   Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
   // Part of the official API:
   //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
   static bool isRequired() { return true; }
 
 private:
+  const Carried *carried;
+
   // A special type used by analysis passes to provide an address that
   // identifies that particular analysis pass type.
   static llvm::AnalysisKey Key;
@@ -111,12 +491,20 @@ private:
 struct ModuleTerminationPass
     : public llvm::AnalysisInfoMixin<ModuleTerminationPass> {
   using Result = ModuleTerminationPassResult;
+  // Final results to take as given, like an assume-* annotation, rather than
+  // analyze; see diff<bounded-termination>.
+  using Pinned = llvm::DenseMap<const llvm::Function *, TerminationPassResult>;
+
+  explicit ModuleTerminationPass(const Pinned *pinned = nullptr)
+      : pinned(pinned) {}
   Result run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM);
   // Part of the official API:
   //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
   static bool isRequired() { return true; }
 
 private:
+  const Pinned *pinned;
+
   // A special type used by analysis passes to provide an address that
   // identifies that particular analysis pass type.
   static llvm::AnalysisKey Key;
@@ -154,120 +542,388 @@ private:
   llvm::raw_ostream &OS;
 };
 
+// Attaches each block's verdict to its terminator, as kTerminationMetadata.
+struct BoundedTerminationAnnotator
+    : public llvm::PassInfoMixin<BoundedTerminationAnnotator> {
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+};
+
+// Reports the module-level results as optimization remarks, e.g. for
+//   clang -fpass-plugin=... -Rpass-analysis=bounded-termination
+//   clang -fpass-plugin=... -fsave-optimization-record
+// which runs this at the end of the optimization pipeline. There, it does
+// nothing unless remarks from bounded-termination were asked for: loading
+// the plugin alone shouldn't add the analysis (or its must-be-bounded
+// errors) to every build.
+class BoundedTerminationRemarks
+    : public llvm::PassInfoMixin<BoundedTerminationRemarks> {
+public:
+  explicit BoundedTerminationRemarks(bool only_if_requested = false)
+      : only_if_requested(only_if_requested) {}
+  llvm::PreservedAnalyses run(llvm::Module &IR,
+                              llvm::ModuleAnalysisManager &AM);
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+
+private:
+  bool only_if_requested;
+};
+
+// Writes each function's result to -bounded-termination-baseline, for a
+// later diff<bounded-termination> to compare against. One line each:
+//   <mangled name> <result> <fingerprint> <explanation>
+// separated by tabs, after a header line with the options that matter.
+struct BoundedTerminationBaselineWriter
+    : public llvm::PassInfoMixin<BoundedTerminationBaselineWriter> {
+  llvm::PreservedAnalyses run(llvm::Module &IR,
+                              llvm::ModuleAnalysisManager &AM);
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+};
+
+// Reports only the functions whose result moved since the baseline
+// (-bounded-termination-baseline), regressions from Bounded first, with the
+// call chain that explains each; it's an error if there are any.
+// Functions whose code hasn't changed, and that don't reach any code that
+// has, keep their baseline result without being analyzed again.
+class BoundedTerminationDiff
+    : public llvm::PassInfoMixin<BoundedTerminationDiff> {
+public:
+  explicit BoundedTerminationDiff(llvm::raw_ostream &OutS) : OS(OutS) {}
+  llvm::PreservedAnalyses run(llvm::Module &IR,
+                              llvm::ModuleAnalysisManager &AM);
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+// A results file from save<bounded-termination>.
+struct Baseline {
+  struct Entry {
+    DoesThisTerminate elt = DoesThisTerminate::Unevaluated;
+    uint64_t fingerprint = 0;
+    std::string explanation;
+  };
+  // The options it was written with; see baseline_settings.
+  std::string settings;
+  llvm::StringMap<Entry> functions;
+};
+
+// Keeps the module's file and results loaded, and answers questions about
+// them on a Unix socket (-bounded-termination-socket) until told to stop:
+//   query <function>   what print<bounded-termination> says about it
+//   reload             re-read the file even if it hasn't changed
+//   shutdown
+// One request per line; each reply ends with an empty line. If the file
+// changed since the last request, only the functions that changed (and
+// their callers) are analyzed again.
+struct BoundedTerminationDaemon
+    : public llvm::PassInfoMixin<BoundedTerminationDaemon> {
+  llvm::PreservedAnalyses run(llvm::Module &IR,
+                              llvm::ModuleAnalysisManager &AM);
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+};
+
+// What serve<bounded-termination> keeps between requests: the module as of
+// the last time its file changed, and the analysis results for it.
+class ResidentModule {
+public:
+  explicit ResidentModule(std::string path) : path(std::move(path)) {}
+
+  // Re-reads the file if it changed since last time (or if `force`).
+  // Returns what happened, for the client; empty if nothing did.
+  std::string refresh(bool force);
+  bool loaded() const { return module != nullptr; }
+
+  // Writes what print<bounded-termination> says about `name`
+  // (mangled or demangled).
+  void query(llvm::StringRef name, llvm::raw_ostream &os);
+
+private:
+  struct Analyses {
+    llvm::PassBuilder PB;
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+  };
+
+  std::string path;
+  llvm::sys::TimePoint<> modified;
+  // Torn down in reverse: the results, then the module, then its context.
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+  // Of each function's code, by name.
+  llvm::StringMap<uint64_t> fingerprints;
+  FunctionTerminationPass::Carried carried;
+  std::unique_ptr<Analyses> analyses;
+};
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+
+// What to do with attributes like `willreturn` that already say whether
+// something terminates.
+enum class AttributeMode {
+  // Take them at their word: calls and functions they cover aren't analyzed.
+  Trust,
+  // Analyze anyway, and report where the analysis disagrees.
+  Verify,
+};
+
+static llvm::cl::opt<AttributeMode> attribute_mode(
+    "bounded-termination-attributes",
+    llvm::cl::desc("How to treat willreturn, noreturn, etc."),
+    llvm::cl::values(clEnumValN(AttributeMode::Trust, "trust",
+                                "Use them in place of analysis"),
+                     clEnumValN(AttributeMode::Verify, "verify",
+                                "Analyze anyway and report disagreements")),
+    llvm::cl::init(AttributeMode::Trust));
+
+// What to do with the paths taken once an exception is thrown.
+enum class UnwindMode {
+  // They're part of the function's result, like any other path.
+  Join,
+  // They're reported on their own; the result is the normal path's.
+  Separate,
+};
+
+static llvm::cl::opt<UnwindMode> unwind_mode(
+    "bounded-termination-unwind",
+    llvm::cl::desc("How to count the paths taken once an exception is thrown"),
+    llvm::cl::values(
+        clEnumValN(UnwindMode::Join, "join",
+                   "In the function's result, like any other path"),
+        clEnumValN(UnwindMode::Separate, "separate",
+                   "On their own, e.g. for code that ships with exceptions "
+                   "disabled")),
+    llvm::cl::init(UnwindMode::Join));
+
+static llvm::cl::opt<bool> whole_program(
+    "bounded-termination-whole-program",
+    llvm::cl::desc("Assume the module is the whole program: an indirect call "
+                   "with no other candidates may reach any address-taken "
+                   "function of its type, and nothing else"));
+
+static llvm::cl::opt<unsigned> trip_threshold(
+    "bounded-termination-trip-threshold",
+    llvm::cl::desc("Report profiled loops that average more iterations "
+                   "than this"),
+    llvm::cl::init(1000));
+
+static llvm::cl::opt<uint64_t> stack_limit(
+    "bounded-termination-stack-limit",
+    llvm::cl::desc("Fail if a root or must-be-bounded function may use more "
+                   "than this many bytes of stack (0: no limit)"),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<bool> cycles_option(
+    "bounded-termination-cycles",
+    llvm::cl::desc("Estimate each function's worst-case cycles, using the "
+                   "target's cost model"));
+
+static llvm::cl::opt<std::string> cycle_table(
+    "bounded-termination-cycle-table",
+    llvm::cl::desc("Cycles for each opcode, one \"<opcode> <cycles>\" per "
+                   "line, to use instead of the target's cost model "
+                   "(implies -bounded-termination-cycles)"));
+
+static llvm::cl::opt<uint64_t> cycle_limit(
+    "bounded-termination-cycle-limit",
+    llvm::cl::desc("Fail if a root or must-be-bounded function may take more "
+                   "than this many cycles (0: no limit; implies "
+                   "-bounded-termination-cycles)"),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<std::string> slow_calls_file(
+    "bounded-termination-slow-calls",
+    llvm::cl::desc("More slow runtime calls to count, one \"<kind> <name>\" "
+                   "per line (kinds: allocation, lock, logging, io; a "
+                   "trailing '*' matches any rest of the name)"));
+
+static llvm::cl::list<SlowCallKind> banned_kinds(
+    "bounded-termination-ban",
+    llvm::cl::desc("Fail if a must-be-bounded function may make slow calls "
+                   "of these kinds"),
+    llvm::cl::values(
+        clEnumValN(SlowCallKind::Allocation, "allocation",
+                   "malloc, operator new, ..."),
+        clEnumValN(SlowCallKind::Lock, "lock", "pthread_mutex_lock, ..."),
+        clEnumValN(SlowCallKind::Logging, "logging", "printf, syslog, ..."),
+        clEnumValN(SlowCallKind::IO, "io", "read, write, fflush, ...")),
+    llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<std::string> baseline_path(
+    "bounded-termination-baseline",
+    llvm::cl::desc("Results file that save<bounded-termination> writes and "
+                   "diff<bounded-termination> compares against"),
+    llvm::cl::init("bounded-termination.baseline"));
+
+static llvm::cl::opt<std::string> socket_path(
+    "bounded-termination-socket",
+    llvm::cl::desc("Where serve<bounded-termination> listens"),
+    llvm::cl::init("bounded-termination.sock"));
+
 //------------------------------------------------------------------------------
 // Free functions
 //------------------------------------------------------------------------------
 
-bool operator<(const TerminationPassResult &a, const TerminationPassResult &b) {
-  if (a.elt == b.elt) {
-    return a.explanation < b.explanation;
-  } else {
-    return a.elt < b.elt;
+// Whether bounded-termination remarks go anywhere: -Rpass-analysis, or an
+// optimization record whose filter (if any) takes them.
+bool remarks_requested(llvm::LLVMContext &context) {
+  if (context.getDiagHandlerPtr()->isAnalysisRemarkEnabled(
+          "bounded-termination")) {
+    return true;
   }
+  llvm::remarks::RemarkStreamer *streamer = context.getMainRemarkStreamer();
+  return streamer != nullptr && streamer->matchesFilter("bounded-termination");
 }
 
-llvm::StringRef to_string(DoesThisTerminate t) {
-  switch (t) {
-  case DoesThisTerminate::Unevaluated:
-    return "Unevaluated";
-  case DoesThisTerminate::Bounded:
-    return "Bounded";
-  case DoesThisTerminate::Unbounded:
-    return "Unbounded";
-  case DoesThisTerminate::Unknown:
-    return "Unknown";
+llvm::StringRef to_string(SlowCallKind kind) {
+  switch (kind) {
+  case SlowCallKind::Allocation:
+    return "allocation";
+  case SlowCallKind::Lock:
+    return "lock";
+  case SlowCallKind::Logging:
+    return "logging";
+  case SlowCallKind::IO:
+    return "io";
   }
 }
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                              const DoesThisTerminate &dt) {
-  os << to_string(dt);
+                              const RecursionBound &bound) {
+  os << "at most " << bound.depth << " calls deep on argument "
+     << bound.argument << " ("
+     << (bound.from_module_calls ? "from the calls in this module"
+                                 : "from any argument")
+     << "), " << bound.stack_bytes << " bytes of locals";
   return os;
 }
 
-std::string friendly_name_block(llvm::StringRef unfriendly) {
-  llvm::StringRef tail = unfriendly;
-  llvm::StringRef head;
-  std::string result;
-  while (tail != "") {
-    auto spl = tail.split('.');
-    head = spl.first;
-    tail = spl.second;
-    result.append(llvm::demangle(head));
-    if (tail != "") {
-      result.push_back('.');
-    }
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                              const StackBound &bound) {
+  if (bound.unbounded.empty()) {
+    os << bound.bytes << " bytes of locals on the deepest path";
+  } else {
+    os << "unbounded: " << bound.unbounded;
   }
-
-  return result;
+  // With no locals anywhere, any path is as deep as any other.
+  const bool deep = bound.bytes != 0 || !bound.unbounded.empty();
+  for (size_t i = 0; deep && i < bound.path.size(); ++i) {
+    os << (i == 0 ? ", via " : " -> ")
+       << demangled_name(bound.path[i]->getName());
+  }
+  if (bound.calls_unknown) {
+    os << ", not counting calls out of the module";
+  }
+  return os;
 }
 
-TerminationPassResult join(TerminationPassResult res1,
-                           TerminationPassResult res2) {
-  TerminationPassResult minResult = std::min(res1, res2);
-  TerminationPassResult maxResult = std::max(res1, res2);
-
-  if (minResult.elt == DoesThisTerminate::Unevaluated) {
-    return maxResult;
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const CycleCost &cost) {
+  if (cost.unbounded.empty()) {
+    os << cost.cycles << " cycles on the longest path";
+  } else {
+    os << "unbounded: " << cost.unbounded;
   }
-
-  // Does not take the interior edge as part of the lattice.
-  if (minResult.elt == DoesThisTerminate::Bounded) {
-    if (maxResult.elt == DoesThisTerminate::Unbounded) {
-      return TerminationPassResult{
-          .elt = DoesThisTerminate::Unknown,
-          .explanation =
-              "Joined with Unbounded branch: " + maxResult.explanation,
-      };
+  auto cycles = [](uint64_t cycles) {
+    return cycles == MaxCostLattice::kUnbounded ? std::string("unbounded")
+                                                : std::to_string(cycles);
+  };
+  if (cost.normal) {
+    os << " (normal path " << cycles(*cost.normal);
+    if (cost.unwind) {
+      os << ", unwind path " << cycles(*cost.unwind);
     }
+    os << ")";
+  }
+  if (cost.calls_unknown) {
+    os << ", not counting calls out of the module";
+  }
+  return os;
+}
 
-    return maxResult;
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                              const SlowCalls::Count &count) {
+  if (count.unbounded.empty()) {
+    os << "up to " << count.calls;
+  } else {
+    os << "unbounded";
+  }
+  if (count.example != nullptr) {
+    os << ", e.g. " << demangled_name(count.example->getName());
   }
+  if (!count.unbounded.empty()) {
+    os << ": " << count.unbounded;
+  }
+  return os;
+}
 
-  if (minResult.elt == DoesThisTerminate::Unbounded) {
-    if (maxResult.elt == DoesThisTerminate::Unbounded) {
-      return TerminationPassResult{
-          .elt = DoesThisTerminate::Unbounded,
-          .explanation = "Joined two Unbounded branches: (" +
-                         minResult.explanation + "), (" +
-                         maxResult.explanation + ")",
-      };
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const LoopProfile &lp) {
+  os << lp.elt << " loop at " << friendly_name(lp.header->getName())
+     << ", header ran " << lp.header_count
+     << " times";
+  if (lp.trip_count) {
+    os << ", ~" << *lp.trip_count << " iterations per entry";
+    if (*lp.trip_count > trip_threshold) {
+      os << " (over " << trip_threshold << ")";
     }
   }
-
-  return maxResult;
+  return os;
 }
 
-// TODO: If we fix propagation back towards the BB source,
-// can this be fully replaced with `join`?
-TerminationPassResult update(TerminationPassResult result,
-                             std::vector<TerminationPassResult> pred_results) {
-
-  TerminationPassResult predecessor_result;
-  for (const auto &predecessor : pred_results) {
-    predecessor_result = join(predecessor_result, predecessor);
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const ContendedLoop &cl) {
+  switch (cl.kind) {
+  case ContendedLoop::Kind::CompareExchangeRetry:
+    os << "compare-and-swap retry loop";
+    break;
+  case ContendedLoop::Kind::SpinWait:
+    os << "spin-wait loop";
+    break;
   }
+  os << " at " << friendly_name(cl.header->getName()) << ", contending on "
+     << cl.location;
+  return os;
+}
 
-  // After joining all predecessors, we have one special exception to the
-  // 'join' rule.
-  //
-  // 'join' works for symmetric results, but we have an asymmetry here:
-  // if all predecessors are `Unbounded` and this is `Bounded`, then this node
-  // is `Unbounded` as well,
-  // TODO: This should be "just always unbounded", but adding an
-  // unknown-to-unbounded transition would prevent convergence. What to do?
-  if (result.elt == DoesThisTerminate::Bounded &&
-      predecessor_result.elt == DoesThisTerminate::Unbounded) {
-    return predecessor_result;
-  } else {
-    return join(result, predecessor_result);
+// Picks which of `after` (the values of a node's successors) explains how the
+// node came to have `value`.
+// Prefers a successor with that value outright; failing that, one that brings
+// in the possibility of not terminating, which `joined` is set for.
+// Returns after.size() if nothing does.
+size_t pick_witness(DoesThisTerminate value,
+                    llvm::ArrayRef<DoesThisTerminate> after, bool *joined) {
+  *joined = false;
+  for (size_t i = 0; i < after.size(); ++i) {
+    if (after[i] == value) {
+      return i;
+    }
+  }
+  for (size_t i = 0; i < after.size(); ++i) {
+    if (static_cast<unsigned>(after[i]) & kMayDiverge) {
+      *joined = true;
+      return i;
+    }
   }
+  return after.size();
 }
 
 // Reports whether the loop is bounded, or unknown.
-// TODO: Report "unbounded" if there is no exit from the loop.
-// TODO: ...and handle the "this function has a loop with no exit";
-// means that we have to propagate back to the entry block, look there.
+// A loop with no exit is Unknown here; aggregating over the blocks
+// (FunctionTerminationPass::run) is what finds that it never gets out.
 TerminationPassResult loopClassifier(const llvm::Loop &loop,
                                      llvm::ScalarEvolution &SE) {
   std::optional<llvm::Loop::LoopBounds> bounds = loop.getBounds(SE);
@@ -281,136 +937,2892 @@ TerminationPassResult loopClassifier(const llvm::Loop &loop,
                                    "includes a loop, but it has a fixed bound"};
 }
 
-//------------------------------------------------------------------------------
-// Pass bodies
-//------------------------------------------------------------------------------
+// The test that ends a loop, as SCEVs: the loop keeps going while
+// `stay(iv, limit)`, where `iv` is an affine recurrence in the loop and
+// `limit` doesn't change in it.
+struct LoopExitTest {
+  llvm::CmpInst::Predicate stay;
+  const llvm::SCEVAddRecExpr *iv;
+  const llvm::SCEV *limit;
+};
 
-FunctionTerminationPass::Result
-FunctionTerminationPass::run(llvm::Function &F,
-                             llvm::FunctionAnalysisManager &FAM) {
-  if (F.empty()) {
-    return FunctionTerminationPass::Result{
-        .elt = DoesThisTerminate::Unknown,
-        .explanation = "has no basic blocks in this module",
-    };
+std::optional<LoopExitTest> exitTest(const llvm::Loop &loop,
+                                     const llvm::BasicBlock &exiting,
+                                     llvm::ScalarEvolution &SE) {
+  const auto *branch =
+      llvm::dyn_cast<llvm::BranchInst>(exiting.getTerminator());
+  if (branch == nullptr || !branch->isConditional()) {
+    return std::nullopt;
   }
+  const auto *compare = llvm::dyn_cast<llvm::ICmpInst>(branch->getCondition());
+  if (compare == nullptr) {
+    return std::nullopt;
+  }
+  llvm::CmpInst::Predicate stay = compare->getPredicate();
+  if (!loop.contains(branch->getSuccessor(0))) {
+    stay = llvm::CmpInst::getInversePredicate(stay);
+  }
+  const llvm::SCEV *lhs = SE.getSCEV(compare->getOperand(0));
+  const llvm::SCEV *rhs = SE.getSCEV(compare->getOperand(1));
+  if (!llvm::isa<llvm::SCEVAddRecExpr>(lhs)) {
+    std::swap(lhs, rhs);
+    stay = llvm::CmpInst::getSwappedPredicate(stay);
+  }
+  const auto *iv = llvm::dyn_cast<llvm::SCEVAddRecExpr>(lhs);
+  if (iv == nullptr || iv->getLoop() != &loop || !iv->isAffine() ||
+      !SE.isLoopInvariant(rhs, &loop)) {
+    return std::nullopt;
+  }
+  return LoopExitTest{.stay = stay, .iv = iv, .limit = rhs};
+}
 
-  llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
-  llvm::LoopInfo &loop_info = FAM.getResult<llvm::LoopAnalysis>(F);
-
-  std::map<llvm::BasicBlock *, TerminationPassResult> blocks_to_results;
-  // SetVector preserves insertion order - which is nice because it makes this
-  // deterministic.
-  llvm::SetVector<llvm::BasicBlock *> outstanding_nodes;
-
-  // Step 1 : do local basic block analysis.
-  // We don't need to do this? Assume every instruction terminates,
-  // including call instructions. (We'll handle them at the call-graph layer.)
-  // for (auto &basic_block : F) {
-  //   TerminationPassResult result = basicBlockClassifier(basic_block);
-  //   blocks_to_results.insert_or_assign(&basic_block, result);
-  //   outstanding_nodes.insert(&basic_block);
-  // }
+// Finds a test, made on every iteration, that depends only on the
+// function's arguments (and constants).
+std::optional<ArgumentBoundedLoop>
+argumentBoundClassifier(const llvm::Loop &loop, llvm::ScalarEvolution &SE,
+                        const llvm::DominatorTree &DT) {
+  const llvm::BasicBlock *latch = loop.getLoopLatch();
+  if (latch == nullptr) {
+    return std::nullopt;
+  }
+  struct ArgumentCollector {
+    llvm::SmallVector<unsigned, 2> arguments;
+    bool only_arguments = true;
 
-  // Step 2 : do loop-level analysis.
-  // We need a ScalarEvolution to get the loops.
-  // The blocks_to_results map is empty before we start this.
-  for (auto &basic_block : F) {
-    llvm::Loop *loop = loop_info.getLoopFor(&basic_block);
-    if (loop == nullptr) {
-      // Block is (locally) bounded.
-      blocks_to_results.insert_or_assign(&basic_block,
-                                         TerminationPassResult{
-                                             .elt = DoesThisTerminate::Bounded,
-                                             .explanation = "",
-                                         });
+    bool follow(const llvm::SCEV *S) {
+      if (const auto *unknown = llvm::dyn_cast<llvm::SCEVUnknown>(S)) {
+        const auto *argument =
+            llvm::dyn_cast<llvm::Argument>(unknown->getValue());
+        if (argument == nullptr) {
+          only_arguments = false;
+        } else if (!llvm::is_contained(arguments, argument->getArgNo())) {
+          arguments.push_back(argument->getArgNo());
+        }
+      }
+      return true;
+    }
+    bool isDone() const { return !only_arguments; }
+  };
+  llvm::SmallVector<llvm::BasicBlock *, 4> exiting;
+  loop.getExitingBlocks(exiting);
+  for (const llvm::BasicBlock *block : exiting) {
+    if (!DT.dominates(block, latch)) {
       continue;
     }
-    // If the loop is bounded, we count this node as bounded too.
-    auto result = loopClassifier(*loop, SE);
-    blocks_to_results.insert_or_assign(&basic_block, result);
+    const std::optional<LoopExitTest> test = exitTest(loop, *block, SE);
+    if (!test) {
+      continue;
+    }
+    ArgumentCollector collector;
+    llvm::visitAll(test->iv, collector);
+    llvm::visitAll(test->limit, collector);
+    if (collector.only_arguments && !collector.arguments.empty()) {
+      llvm::sort(collector.arguments);
+      return ArgumentBoundedLoop{
+          .header = loop.getHeader(),
+          .exiting = block,
+          .arguments = std::move(collector.arguments),
+      };
+    }
   }
-  // All blocks are labeled:
-  // - Bounded if not part of a loop.
-  // - Unbounded if an infinite loop (no exit) -- note, hypothetical, this is a TODO
-  // - Unknown if a loop bound cannot be determined
-
-  // Step 3 : aggregate results.
-  // In order to accurately capture:
-  /*
-  * void maybe_hold(bool stall) {
-  *   if(stall) {
-  *     while(true) {}
-  *   } else {
-  *     return;
-  *   }
-  */
-  // We need to propagate towards the entry block,
-  // then use the entry block to determine the function's result.
-  // Is "worklist towards the entry" equivalent "`join` over all results"?
-  // No, we still do need 'update', with its slightly-different semantics from 'join'.
-
-  // Worklist version (towards source):
-  for(llvm::BasicBlock &block : F) {
-    // We add everything, even the non-exit nodes,
-    // so that we make sure we eventually get back to the entry block.
-    // Consider:
-    // void does_not_terminate(bool stall) {
-    //   if(stall) { // entry block: B1, successors are B2/B3
-    //     while(true) {} // B2: predecessors are is B1, B2, successor is B2
-    //   } else {
-    //     while(true) {} // B3: predecessors are B1, B3, successor is B3
-    //  }
-    //  // B4? Exit block? May not exist, has no predecessors
-    // }
-    // We need to make sure that we propagate from non-exiting paths
-    // (Unbounded) to the entry block; so, add everything to begin with,
-    // and just iterate the worklist until we hit a fixpoint.
-    // We still know it will quiesce due to the convergent nature of update().
-    outstanding_nodes.insert(&block);
-  }
-  while (!outstanding_nodes.empty()) {
-    llvm::BasicBlock *block = outstanding_nodes.pop_back_val();
-    auto original = blocks_to_results.at(block);
-    std::vector<TerminationPassResult> results;
-    for (llvm::BasicBlock *successor : llvm::successors(block)) {
-      results.emplace_back(blocks_to_results.at(successor));
-    }
-    auto altered = update(original, std::move(results));
-    blocks_to_results.insert_or_assign(block, altered);
-    if (altered.elt != original.elt) {
-      for (auto *predecessor : llvm::predecessors(block)) {
-        outstanding_nodes.insert(predecessor);
-      }
-    }
-  }
-
-  return blocks_to_results.at(&F.getEntryBlock());
+  return std::nullopt;
 }
 
-ModuleTerminationPass::Result
-ModuleTerminationPass::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
-  std::map<const llvm::Function *, TerminationPassResult> per_function_results;
+// Does {start,+,step} (wrapping) ever reach a value where `stay` fails?
+bool eventuallyExits(llvm::CmpInst::Predicate stay, const llvm::APInt &start,
+                     const llvm::APInt &step, const llvm::APInt &limit) {
+  const llvm::ConstantRange exits = llvm::ConstantRange::makeExactICmpRegion(
+      llvm::CmpInst::getInversePredicate(stay), limit);
+  if (step.isZero()) {
+    return exits.contains(start);
+  }
+  if (exits.isEmptySet() || exits.isFullSet()) {
+    return exits.isFullSet();
+  }
+  // Stepping visits every value congruent to `start` modulo the largest
+  // power of two dividing `step`, and nothing else; so we exit if the exit
+  // range is at least that long, or has such a value near its start.
+  const unsigned width = start.getBitWidth();
+  const unsigned shift = step.countr_zero();
+  const llvm::APInt size = exits.getUpper() - exits.getLower();
+  if (size.uge(llvm::APInt::getOneBitSet(width, shift))) {
+    return true;
+  }
+  const llvm::APInt first =
+      (start - exits.getLower()) & llvm::APInt::getLowBitsSet(width, shift);
+  return first.ult(size);
+}
+
+// The values of `argument` for which `call` can run, from the branches that
+// dominate it.
+llvm::ConstantRange guardRange(const llvm::CallBase &call,
+                               const llvm::Argument &argument,
+                               const llvm::DominatorTree &DT) {
+  const unsigned width = argument.getType()->getIntegerBitWidth();
+  llvm::ConstantRange range = llvm::ConstantRange::getFull(width);
+  for (const llvm::DomTreeNode *node = DT.getNode(call.getParent());
+       node != nullptr && node->getIDom() != nullptr; node = node->getIDom()) {
+    const llvm::BasicBlock *dominator = node->getIDom()->getBlock();
+    const auto *branch =
+        llvm::dyn_cast<llvm::BranchInst>(dominator->getTerminator());
+    if (branch == nullptr || !branch->isConditional()) {
+      continue;
+    }
+    const auto *compare =
+        llvm::dyn_cast<llvm::ICmpInst>(branch->getCondition());
+    if (compare == nullptr) {
+      continue;
+    }
+    llvm::CmpInst::Predicate predicate = compare->getPredicate();
+    const llvm::Value *lhs = compare->getOperand(0);
+    const llvm::Value *rhs = compare->getOperand(1);
+    if (rhs == &argument) {
+      std::swap(lhs, rhs);
+      predicate = llvm::CmpInst::getSwappedPredicate(predicate);
+    }
+    const auto *bound = llvm::dyn_cast<llvm::ConstantInt>(rhs);
+    if (lhs != &argument || bound == nullptr) {
+      continue;
+    }
+    for (unsigned successor = 0; successor < 2; ++successor) {
+      const llvm::BasicBlockEdge edge(dominator,
+                                      branch->getSuccessor(successor));
+      if (DT.dominates(edge, call.getParent())) {
+        range = range.intersectWith(llvm::ConstantRange::makeExactICmpRegion(
+            successor == 0 ? predicate
+                           : llvm::CmpInst::getInversePredicate(predicate),
+            bound->getValue()));
+      }
+    }
+  }
+  return range;
+}
+
+// Bytes of fixed-size allocas in `F`.
+uint64_t frameBytes(const llvm::Function &F) {
+  const llvm::DataLayout &DL = F.getParent()->getDataLayout();
+  uint64_t bytes = 0;
+  for (const llvm::Instruction &I : F.getEntryBlock()) {
+    const auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&I);
+    if (alloca == nullptr || !alloca->isStaticAlloca()) {
+      continue;
+    }
+    const auto *count = llvm::cast<llvm::ConstantInt>(alloca->getArraySize());
+    bytes += DL.getTypeAllocSize(alloca->getAllocatedType()).getFixedValue() *
+             count->getZExtValue();
+  }
+  return bytes;
+}
+
+// Tries to bound the depth of a recursive group, using argument `k` as the
+// measure: every call within the group must pass its own argument `k` plus
+// or minus one (the same way throughout), behind a guard on that argument.
+// Stepping one at a time, the measure must then leave the guarded range.
+std::optional<RecursionBound>
+measureClassifier(llvm::ArrayRef<llvm::Function *> scc, unsigned k,
+                  llvm::FunctionAnalysisManager &FAM) {
+  llvm::SmallPtrSet<const llvm::Function *, 8> members(scc.begin(), scc.end());
+  llvm::Type *type = scc.front()->getArg(k)->getType();
+  if (!type->isIntegerTy()) {
+    return std::nullopt;
+  }
+  const unsigned width = type->getIntegerBitWidth();
+  int64_t step = 0;
+  llvm::ConstantRange recursing = llvm::ConstantRange::getEmpty(width);
+  for (llvm::Function *F : scc) {
+    const llvm::Argument *argument = F->getArg(k);
+    if (argument->getType() != type) {
+      return std::nullopt;
+    }
+    llvm::ScalarEvolution &SE =
+        FAM.getResult<llvm::ScalarEvolutionAnalysis>(*F);
+    const llvm::DominatorTree &DT =
+        FAM.getResult<llvm::DominatorTreeAnalysis>(*F);
+    for (const llvm::BasicBlock &BB : *F) {
+      for (const llvm::Instruction &I : BB) {
+        const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+        if (call == nullptr || !members.contains(call->getCalledFunction())) {
+          continue;
+        }
+        const auto *delta = llvm::dyn_cast<llvm::SCEVConstant>(
+            SE.getMinusSCEV(SE.getSCEV(call->getArgOperand(k)),
+                            SE.getSCEV(const_cast<llvm::Argument *>(argument))));
+        if (delta == nullptr) {
+          return std::nullopt;
+        }
+        const int64_t this_step = delta->getAPInt().getSExtValue();
+        if ((this_step != 1 && this_step != -1) ||
+            (step != 0 && step != this_step)) {
+          return std::nullopt;
+        }
+        step = this_step;
+        recursing = recursing.unionWith(guardRange(*call, *argument, DT));
+      }
+    }
+  }
+  const llvm::ConstantRange stopping = recursing.inverse();
+  if (step == 0 || stopping.isEmptySet()) {
+    return std::nullopt;
+  }
+
+  // Frames from entering the group with `value`: step through `recursing`
+  // until we reach `stopping`.
+  auto depth_from = [&](const llvm::APInt &value) -> uint64_t {
+    if (!recursing.contains(value)) {
+      return 1;
+    }
+    const llvm::APInt steps = step > 0
+                                  ? stopping.getLower() - value
+                                  : value - (stopping.getUpper() - 1);
+    return steps.getLimitedValue(UINT64_MAX - 1) + 1;
+  };
+  // With callers we can't see, assume the worst entry.
+  const uint64_t worst =
+      recursing.isEmptySet()
+          ? 1
+          : (recursing.getUpper() - recursing.getLower())
+                    .getLimitedValue(UINT64_MAX - 1) +
+                1;
+  bool from_module_calls = true;
+  uint64_t depth = 1;
+  uint64_t frame = 0;
+  for (const llvm::Function *F : scc) {
+    frame = std::max(frame, frameBytes(*F));
+    if (!F->hasLocalLinkage()) {
+      from_module_calls = false;
+    }
+    for (const llvm::User *user : F->users()) {
+      const auto *call = llvm::dyn_cast<llvm::CallBase>(user);
+      if (call == nullptr || call->getCalledFunction() != F) {
+        // Address taken: called from who knows where.
+        from_module_calls = false;
+        continue;
+      }
+      if (members.contains(call->getFunction())) {
+        continue;
+      }
+      const auto *value = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(k));
+      depth = std::max(depth, value ? depth_from(value->getValue()) : worst);
+    }
+  }
+  if (!from_module_calls) {
+    depth = worst;
+  }
+  const uint64_t stack_bytes =
+      frame != 0 && depth > UINT64_MAX / frame ? UINT64_MAX : depth * frame;
+  return RecursionBound{
+      .argument = k,
+      .depth = depth,
+      .stack_bytes = stack_bytes,
+      .from_module_calls = from_module_calls,
+  };
+}
+
+// Names the memory an atomic or volatile access touches, and where from.
+std::string describe_location(const llvm::Value *pointer,
+                              const llvm::Instruction &access) {
+  std::string description;
+  llvm::raw_string_ostream os(description);
+  const llvm::Value *base = pointer->stripPointerCasts();
+  if (base->hasName()) {
+    os << friendly_name(base->getName());
+  } else {
+    base->printAsOperand(os, /*PrintType=*/false);
+  }
+  if (const llvm::DebugLoc &loc = access.getDebugLoc()) {
+    os << " (";
+    loc.print(os);
+    os << ")";
+  }
+  return description;
+}
+
+// Does `loop` only exit once it wins a race?
+// Looks for an exit condition computed from a compare-and-swap's success
+// flag, or from an atomic / volatile read of shared memory.
+std::optional<ContendedLoop> contentionClassifier(const llvm::Loop &loop) {
+  llvm::SmallVector<llvm::BasicBlock *, 4> exiting_blocks;
+  loop.getExitingBlocks(exiting_blocks);
+  for (const llvm::BasicBlock *exiting : exiting_blocks) {
+    const auto *branch =
+        llvm::dyn_cast<llvm::BranchInst>(exiting->getTerminator());
+    if (branch == nullptr || !branch->isConditional()) {
+      continue;
+    }
+    // Walk back from the condition through comparisons, casts, and phis;
+    // don't go far, exit conditions are short.
+    llvm::SmallVector<const llvm::Value *, 8> worklist = {
+        branch->getCondition()};
+    llvm::SmallPtrSet<const llvm::Value *, 16> seen;
+    while (!worklist.empty() && seen.size() < 16) {
+      const llvm::Value *value = worklist.pop_back_val();
+      const auto *inst = llvm::dyn_cast<llvm::Instruction>(value);
+      if (inst == nullptr || !loop.contains(inst) ||
+          !seen.insert(inst).second) {
+        continue;
+      }
+      if (const auto *extract = llvm::dyn_cast<llvm::ExtractValueInst>(inst)) {
+        inst = llvm::dyn_cast<llvm::Instruction>(
+            extract->getAggregateOperand());
+        if (inst == nullptr || !loop.contains(inst)) {
+          continue;
+        }
+      }
+      if (const auto *cas = llvm::dyn_cast<llvm::AtomicCmpXchgInst>(inst)) {
+        return ContendedLoop{
+            .kind = ContendedLoop::Kind::CompareExchangeRetry,
+            .header = loop.getHeader(),
+            .location = describe_location(cas->getPointerOperand(), *cas),
+        };
+      }
+      if (const auto *rmw = llvm::dyn_cast<llvm::AtomicRMWInst>(inst)) {
+        return ContendedLoop{
+            .kind = ContendedLoop::Kind::SpinWait,
+            .header = loop.getHeader(),
+            .location = describe_location(rmw->getPointerOperand(), *rmw),
+        };
+      }
+      if (const auto *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+        if (load->isAtomic() || load->isVolatile()) {
+          return ContendedLoop{
+              .kind = ContendedLoop::Kind::SpinWait,
+              .header = loop.getHeader(),
+              .location = describe_location(load->getPointerOperand(), *load),
+          };
+        }
+        continue;
+      }
+      if (llvm::isa<llvm::CmpInst, llvm::BinaryOperator, llvm::CastInst,
+                    llvm::SelectInst, llvm::PHINode, llvm::FreezeInst>(inst)) {
+        for (const llvm::Value *operand : inst->operands()) {
+          worklist.push_back(operand);
+        }
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+// What an instruction does to termination, on its own.
+enum class InstructionKind : uint8_t {
+  // Always completes.
+  Bounded,
+  // Completes, but is worth noting if it's volatile.
+  Memory,
+  // Depends on what's called; look closer.
+  Call,
+};
+
+// What an intrinsic does to termination, on its own.
+enum class IntrinsicKind : uint8_t {
+  Bounded,
+  // Takes time proportional to its length argument.
+  Length,
+  // Hands control to something we can't see.
+  Unknown,
+};
+
+constexpr std::array<InstructionKind, llvm::Instruction::OtherOpsEnd>
+    kOpcodeKinds = [] {
+      std::array<InstructionKind, llvm::Instruction::OtherOpsEnd> kinds{};
+      kinds[llvm::Instruction::Load] = InstructionKind::Memory;
+      kinds[llvm::Instruction::Store] = InstructionKind::Memory;
+      kinds[llvm::Instruction::AtomicCmpXchg] = InstructionKind::Memory;
+      kinds[llvm::Instruction::AtomicRMW] = InstructionKind::Memory;
+      kinds[llvm::Instruction::Call] = InstructionKind::Call;
+      kinds[llvm::Instruction::Invoke] = InstructionKind::Call;
+      kinds[llvm::Instruction::CallBr] = InstructionKind::Call;
+      return kinds;
+    }();
+
+// Most intrinsics are arithmetic or bookkeeping, and complete.
+constexpr std::array<IntrinsicKind, llvm::Intrinsic::num_intrinsics>
+    kIntrinsicKinds = [] {
+      std::array<IntrinsicKind, llvm::Intrinsic::num_intrinsics> kinds{};
+      kinds[llvm::Intrinsic::memcpy] = IntrinsicKind::Length;
+      kinds[llvm::Intrinsic::memmove] = IntrinsicKind::Length;
+      kinds[llvm::Intrinsic::memset] = IntrinsicKind::Length;
+      kinds[llvm::Intrinsic::coro_suspend] = IntrinsicKind::Unknown;
+      return kinds;
+    }();
+
+// Entry points for system calls, and the C library's wrappers for those that
+// wait on something outside the program: input, a connection, a child, a
+// signal, the clock.
+constexpr llvm::StringLiteral kSystemCalls[] = {
+    "syscall", "__syscall", "__syscall_cp", "read", "readv", "pread",
+    "recv", "recvfrom", "recvmsg", "accept", "accept4", "select", "pselect",
+    "poll", "ppoll", "epoll_wait", "epoll_pwait", "pause", "sigsuspend",
+    "sigwait", "sigwaitinfo", "sleep", "usleep", "nanosleep",
+    "clock_nanosleep", "wait", "waitpid", "waitid", "wait4",
+};
+
+// Instructions that wait on something outside the program: system calls
+// (x86, Arm, RISC-V) and waits for an interrupt or event.
+constexpr llvm::StringLiteral kBlockingMnemonics[] = {
+    "syscall", "sysenter", "svc", "swi", "ecall", "hlt", "wfi", "wfe",
+};
+
+// Whether any instruction in the inline assembly is one of those. Only
+// mnemonics count, not operands or symbol names that happen to contain one.
+bool is_blocking_asm(llvm::StringRef asm_string) {
+  llvm::SmallVector<llvm::StringRef, 4> lines, statements;
+  asm_string.split(lines, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (llvm::StringRef line : lines) {
+    statements.clear();
+    line.split(statements, ';', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    for (llvm::StringRef statement : statements) {
+      statement = statement.ltrim();
+      // A label ("1: svc 0") comes before the mnemonic.
+      if (auto [label, rest] = statement.split(':');
+          statement.contains(':') && !label.contains(' ') &&
+          !label.contains('\t')) {
+        statement = rest.ltrim();
+      }
+      const llvm::StringRef mnemonic =
+          statement.take_until([](char c) { return llvm::isSpace(c); });
+      const llvm::StringRef operands =
+          statement.drop_front(mnemonic.size()).trim();
+      // Arm width suffixes: "wfi.n".
+      const llvm::StringRef base = mnemonic.split('.').first;
+      for (llvm::StringRef blocking : kBlockingMnemonics) {
+        if (base.equals_insensitive(blocking)) {
+          return true;
+        }
+      }
+      if (base.equals_insensitive("int") && operands == "$$0x80") {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// What the attributes of a function already say about termination, if
+// anything.
+//
+// `willreturn` says it returns; so does the combination of `mustprogress`,
+// `nosync`, and not touching memory, since looping forever without a side
+// effect would be undefined. `noreturn` says it doesn't.
+std::optional<TerminationPassResult>
+attributeClassifier(const llvm::Function &F) {
+  if (F.hasFnAttribute(llvm::Attribute::NoReturn)) {
+    return TerminationPassResult{
+        .elt = DoesThisTerminate::Unbounded,
+        .explanation = "declared noreturn",
+    };
+  }
+  if (F.hasFnAttribute(llvm::Attribute::WillReturn)) {
+    return TerminationPassResult{
+        .elt = DoesThisTerminate::Bounded,
+        .explanation = "declared willreturn",
+    };
+  }
+  if (F.mustProgress() && F.hasFnAttribute(llvm::Attribute::NoSync) &&
+      F.doesNotAccessMemory()) {
+    return TerminationPassResult{
+        .elt = DoesThisTerminate::Bounded,
+        .explanation = "declared mustprogress, nosync, and readnone",
+    };
+  }
+  return std::nullopt;
+}
+
+// Functions that throw (or rethrow) an exception: calls to them leave along
+// the unwind path, rather than never returning.
+bool is_throw(const llvm::Function *callee) {
+  if (callee == nullptr) {
+    return false;
+  }
+  const llvm::StringRef name = callee->getName();
+  return name == "__cxa_throw" || name == "__cxa_rethrow" ||
+         name == "_Unwind_Resume" || name == "_CxxThrowException";
+}
+
+// Classifies a single call; sets `explanation` if it isn't Bounded.
+DoesThisTerminate callClassifier(const llvm::CallBase &call,
+                                 llvm::StringRef *explanation) {
+  if (const auto *assembly =
+          llvm::dyn_cast<llvm::InlineAsm>(call.getCalledOperand())) {
+    if (llvm::StringRef(assembly->getAsmString()).trim().empty()) {
+      // Compiler barrier.
+      return DoesThisTerminate::Bounded;
+    }
+    if (is_blocking_asm(assembly->getAsmString())) {
+      *explanation = "waits for a system call or interrupt in inline assembly";
+      return DoesThisTerminate::Unbounded;
+    }
+    *explanation = "runs inline assembly";
+    return DoesThisTerminate::Unknown;
+  }
+  const llvm::Function *callee = call.getCalledFunction();
+  if (callee == nullptr) {
+    // Indirect; handled at the call-graph layer.
+    return DoesThisTerminate::Bounded;
+  }
+  if (callee->isIntrinsic()) {
+    switch (kIntrinsicKinds[callee->getIntrinsicID()]) {
+    case IntrinsicKind::Bounded:
+      return DoesThisTerminate::Bounded;
+    case IntrinsicKind::Length:
+      if (llvm::isa<llvm::ConstantInt>(call.getArgOperand(2))) {
+        return DoesThisTerminate::Bounded;
+      }
+      *explanation = "copies or sets a data-dependent amount of memory";
+      return DoesThisTerminate::Unknown;
+    case IntrinsicKind::Unknown:
+      *explanation = "suspends a coroutine";
+      return DoesThisTerminate::Unknown;
+    }
+  }
+  if (is_throw(callee)) {
+    // Leaves the function, along the unwind path; see analyzeFunction.
+    return DoesThisTerminate::Bounded;
+  }
+  if (callee->isDeclaration() &&
+      llvm::is_contained(kSystemCalls, callee->getName())) {
+    *explanation = "makes a system call";
+    return DoesThisTerminate::Unbounded;
+  }
+  if (attribute_mode == AttributeMode::Trust &&
+      call.hasFnAttr(llvm::Attribute::NoReturn)) {
+    *explanation = "calls a function declared noreturn";
+    return DoesThisTerminate::Unbounded;
+  }
+  // Everything else is handled at the call-graph layer.
+  return DoesThisTerminate::Bounded;
+}
+
+// The call behind a call-graph edge, if there is one.
+const llvm::CallBase *call_of(const llvm::CallGraphNode::CallRecord &record) {
+  if (!record.first) {
+    return nullptr;
+  }
+  return llvm::dyn_cast_or_null<llvm::CallBase>(
+      static_cast<llvm::Value *>(*record.first));
+}
+
+// Calls that don't need the call-graph layer:
+// - Calls to inline assembly show up in the call graph as calls to an unknown
+//   function, but callClassifier has already looked at them.
+// - Calls with a willreturn attribute (on the call or the callee), if we're
+//   trusting attributes.
+// - Throwing an exception, which callClassifier has also looked at.
+bool is_resolved_locally(const llvm::CallGraphNode::CallRecord &record) {
+  const llvm::CallBase *call = call_of(record);
+  if (call == nullptr) {
+    return false;
+  }
+  return call->isInlineAsm() || is_throw(call->getCalledFunction()) ||
+         (attribute_mode == AttributeMode::Trust &&
+          call->hasFnAttr(llvm::Attribute::WillReturn));
+}
+
+// Result of looking at each instruction of a block, on its own.
+struct BlockClassification {
+  TerminationPassResult result;
+  bool has_volatile = false;
+  // Throws an exception, so it doesn't return normally.
+  bool throws = false;
+  // The block's verdict up to its first throw.
+  DoesThisTerminate before_throw = DoesThisTerminate::Bounded;
+};
+
+// One pass over the block; most instructions are a single table lookup.
+BlockClassification basicBlockClassifier(const llvm::BasicBlock &block) {
+  BlockClassification classification{
+      .result = {.elt = DoesThisTerminate::Bounded, .explanation = ""},
+  };
+  DoesThisTerminate &elt = classification.result.elt;
+  for (const llvm::Instruction &instruction : block) {
+    switch (kOpcodeKinds[instruction.getOpcode()]) {
+    case InstructionKind::Bounded:
+      break;
+    case InstructionKind::Memory:
+      classification.has_volatile |= instruction.isVolatile();
+      break;
+    case InstructionKind::Call: {
+      const auto &call = llvm::cast<llvm::CallBase>(instruction);
+      if (!classification.throws && is_throw(call.getCalledFunction())) {
+        classification.throws = true;
+        classification.before_throw = elt;
+      }
+      llvm::StringRef explanation;
+      const DoesThisTerminate call_elt = callClassifier(call, &explanation);
+      const DoesThisTerminate combined =
+          TerminationLattice::transfer(elt, call_elt);
+      if (combined != elt) {
+        elt = combined;
+        classification.result.explanation = explanation.str();
+      }
+      break;
+    }
+    }
+  }
+  return classification;
+}
+
+// Explains the verdict of block `start` (by default, the entry block) by
+// following the chain of successors that produced it.
+TerminationPassResult
+explainFrom(const DenseGraph &cfg, llvm::ArrayRef<DoesThisTerminate> elts,
+            llvm::ArrayRef<TerminationPassResult> local_results,
+            uint32_t start = 0) {
+  std::string prefix;
+  llvm::BitVector visited(cfg.size());
+  std::vector<DoesThisTerminate> after;
+  for (uint32_t n = start;;) {
+    bool joined = false;
+    size_t witness = cfg.successors(n).size();
+    if (!visited.test(n)) {
+      visited.set(n);
+      after.clear();
+      for (uint32_t successor : cfg.successors(n)) {
+        after.push_back(elts[successor]);
+      }
+      witness = pick_witness(elts[n], after, &joined);
+    }
+    // Stop once this block accounts for the result by itself - unless it has
+    // nothing to say, and a successor with the same result might.
+    if (elts[n] == local_results[n].elt &&
+        (!local_results[n].explanation.empty() ||
+         witness == cfg.successors(n).size() || joined)) {
+      return TerminationPassResult{
+          .elt = elts[start],
+          .explanation = prefix + local_results[n].explanation,
+      };
+    }
+    if (witness == cfg.successors(n).size()) {
+      // Went around a cycle, or found a cycle with nothing in it that
+      // diverges locally: either way, we can't get out.
+      std::string explanation = prefix + local_results[n].explanation;
+      explanation += explanation.empty() ? "never reaches an exit"
+                                         : ", and never reaches an exit";
+      return TerminationPassResult{
+          .elt = elts[start] == DoesThisTerminate::Unevaluated
+                     ? DoesThisTerminate::Unbounded
+                     : elts[start],
+          .explanation = explanation,
+      };
+    }
+    if (joined) {
+      prefix += "Joined with Unbounded branch: ";
+    }
+    n = cfg.successors(n)[witness];
+  }
+}
+
+// Whether to estimate cycles: any of the options that need them.
+bool cycles_enabled() {
+  return cycles_option || !cycle_table.empty() || cycle_limit != 0;
+}
+
+// Reads -bounded-termination-cycle-table: "<opcode> <cycles>" lines, with
+// opcodes named as in the IR ("udiv", "atomicrmw"), and '#' starting a
+// comment. Returns the cycles for each opcode; those it doesn't list take
+// one.
+llvm::Expected<std::vector<uint64_t>>
+read_cycle_table(const std::string &path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer) {
+    return llvm::createStringError(buffer.getError(), "can't read %s: %s",
+                                   path.c_str(),
+                                   buffer.getError().message().c_str());
+  }
+  llvm::StringMap<unsigned> opcodes;
+  for (unsigned opcode = 1; opcode < llvm::Instruction::OtherOpsEnd;
+       ++opcode) {
+    opcodes[llvm::Instruction::getOpcodeName(opcode)] = opcode;
+  }
+  std::vector<uint64_t> table(llvm::Instruction::OtherOpsEnd, 1);
+  for (llvm::line_iterator line(**buffer, /*SkipBlanks=*/true, '#');
+       !line.is_at_eof(); ++line) {
+    llvm::SmallVector<llvm::StringRef, 2> fields;
+    llvm::StringRef(*line).split(fields, ' ', /*MaxSplit=*/-1,
+                                 /*KeepEmpty=*/false);
+    uint64_t cycles;
+    auto opcode = fields.size() == 2 ? opcodes.find(fields[0]) : opcodes.end();
+    if (opcode == opcodes.end() || fields[1].getAsInteger(10, cycles)) {
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(), "%s:%d: not \"<opcode> <cycles>\"",
+          path.c_str(), int(line.line_number()));
+    }
+    table[opcode->second] = cycles;
+  }
+  return table;
+}
+
+// Cycles for each instruction: from a table of cycles per opcode, or else
+// from the target's TargetTransformInfo (its latency estimate). A TTI cost
+// is worked out once per kind of instruction on each target, and looked up
+// after that, so costing a function stays a scan over its instructions.
+class CycleModel {
+public:
+  explicit CycleModel(std::optional<std::vector<uint64_t>> table)
+      : table(std::move(table)) {}
+
+  // Where `F` runs: functions with the same CPU and features share costs.
+  uint32_t target(const llvm::Function &F) {
+    const std::string key =
+        F.getFnAttribute("target-cpu").getValueAsString().str() + "," +
+        F.getFnAttribute("target-features").getValueAsString().str();
+    auto [it, inserted] = targets.try_emplace(key, costs.size());
+    if (inserted) {
+      costs.emplace_back();
+    }
+    return it->second;
+  }
+
+  uint64_t cost(uint32_t target, const llvm::Instruction &I,
+                const llvm::TargetTransformInfo &TTI) {
+    if (table) {
+      return (*table)[I.getOpcode()];
+    }
+    // Near enough what TTI looks at: the opcode, the intrinsic called, and
+    // the result and first operand types.
+    const auto *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&I);
+    const Key key = {
+        I.getOpcode(),
+        intrinsic != nullptr ? unsigned(intrinsic->getIntrinsicID()) : 0u,
+        I.getType(),
+        I.getNumOperands() != 0 ? I.getOperand(0)->getType() : nullptr,
+    };
+    auto [it, inserted] = costs[target].try_emplace(key, 0);
+    if (inserted) {
+      const llvm::InstructionCost cost =
+          TTI.getInstructionCost(&I, llvm::TargetTransformInfo::TCK_Latency);
+      // Costs TTI can't give are for instructions that can't be lowered as
+      // they are; count them as one.
+      it->second = cost.isValid() ? uint64_t(std::max<int64_t>(
+                                        *cost.getValue(), 0))
+                                  : 1;
+    }
+    return it->second;
+  }
+
+private:
+  using Key = std::tuple<unsigned, unsigned, llvm::Type *, llvm::Type *>;
+
+  std::optional<std::vector<uint64_t>> table;
+  llvm::StringMap<uint32_t> targets;
+  std::vector<llvm::DenseMap<Key, uint64_t>> costs;
+};
+
+// A bound on how many times the header of `loop` runs each time the loop is
+// entered: from Loop::getBounds, if its bounds are constants, and from the
+// maximum trip count ScalarEvolution works out; the smaller, if both.
+std::optional<uint64_t> tripBound(const llvm::Loop &loop,
+                                  llvm::ScalarEvolution &SE) {
+  std::optional<uint64_t> bound;
+  if (const unsigned max = SE.getSmallConstantMaxTripCount(&loop)) {
+    bound = max;
+  }
+  std::optional<llvm::Loop::LoopBounds> bounds = loop.getBounds(SE);
+  if (!bounds.has_value()) {
+    return bound;
+  }
+  const auto *initial =
+      llvm::dyn_cast<llvm::ConstantInt>(&bounds->getInitialIVValue());
+  const auto *final =
+      llvm::dyn_cast<llvm::ConstantInt>(&bounds->getFinalIVValue());
+  const auto *step =
+      llvm::dyn_cast_or_null<llvm::ConstantInt>(bounds->getStepValue());
+  if (initial == nullptr || final == nullptr || step == nullptr ||
+      step->isZero()) {
+    return bound;
+  }
+  // One bit wider, so the distance can't overflow.
+  const unsigned width =
+      std::max({initial->getBitWidth(), final->getBitWidth(),
+                step->getBitWidth()}) +
+      1;
+  llvm::APInt distance =
+      final->getValue().sext(width) - initial->getValue().sext(width);
+  if (bounds->getDirection() != llvm::Loop::LoopBounds::Direction::Increasing) {
+    distance.negate();
+  }
+  // One more for the test that leaves, and one in case the step overshoots
+  // (the division rounds down).
+  const uint64_t trips =
+      distance.isStrictlyPositive()
+          ? MaxCostLattice::transfer(
+                distance.udiv(step->getValue().sext(width).abs())
+                    .getLimitedValue(),
+                2)
+          : 1;
+  return bound ? std::min(*bound, trips) : trips;
+}
+
+// The most of something (cycles, calls) along any path from a block of `F`
+// to the end of the function: each block's own amount, times the trip
+// bounds of the loops around it, added up along the longest path once the
+// loops' back edges are taken out.
+class PathCosts {
+public:
+  // Why a block (or what comes after it) has no bound, as an index into
+  // the reasons; kNoReason if it has one.
+  static constexpr uint32_t kNoReason = ~0u;
+
+  PathCosts(const llvm::Function &F, const llvm::LoopInfo &LI,
+            llvm::ScalarEvolution &SE)
+      : F(F), LI(LI) {
+    for (const llvm::BasicBlock &block : F) {
+      ordinals.insert({&block, blocks.size()});
+      blocks.push_back(&block);
+    }
+    // How many times each block runs, for each time the function does.
+    llvm::DenseMap<const llvm::Loop *, std::optional<uint64_t>> bounds;
+    trips.assign(blocks.size(), 1);
+    trips_reason.assign(blocks.size(), kNoReason);
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+      for (const llvm::Loop *loop = LI.getLoopFor(blocks[b]);
+           loop != nullptr; loop = loop->getParentLoop()) {
+        auto [it, inserted] = bounds.try_emplace(loop);
+        if (inserted) {
+          it->second = tripBound(*loop, SE);
+        }
+        if (!it->second) {
+          trips[b] = MaxCostLattice::kUnbounded;
+          trips_reason[b] = reason(
+              "the loop at " +
+              friendly_name(loop->getHeader()->getName()).str() + " in " +
+              demangled_name(F.getName()).str() +
+              " has no constant trip bound");
+          break;
+        }
+        trips[b] = llvm::SaturatingMultiply(trips[b], *it->second);
+      }
+    }
+    clear();
+  }
+
+  size_t size() const { return blocks.size(); }
+  const llvm::BasicBlock *block(uint32_t b) const { return blocks[b]; }
+  const std::string &reason(uint32_t why) const { return reasons[why]; }
+
+  // Starts over, with nothing in any block.
+  void clear() {
+    local.assign(blocks.size(), 0);
+    local_reason.assign(blocks.size(), kNoReason);
+  }
+  // Adds `amount` to block `b`, for each time it runs.
+  void add(uint32_t b, uint64_t amount) {
+    if (amount == 0) {
+      return;
+    }
+    if (trips[b] == MaxCostLattice::kUnbounded) {
+      add_unbounded(b, trips_reason[b]);
+      return;
+    }
+    local[b] = MaxCostLattice::transfer(
+        local[b], llvm::SaturatingMultiply(amount, trips[b]));
+  }
+  // Block `b` has no bound, for `why`.
+  void add_unbounded(uint32_t b, uint32_t why) {
+    if (local_reason[b] == kNoReason) {
+      local_reason[b] = why;
+    }
+    local[b] = MaxCostLattice::kUnbounded;
+  }
+  void add_unbounded(uint32_t b, std::string why) {
+    if (local_reason[b] == kNoReason) {
+      add_unbounded(b, reason(std::move(why)));
+    }
+  }
+
+  // The longest path from each block, and why it has no bound (if it
+  // doesn't). On the `normal` paths, a block in `throws` is where the path
+  // ends, and EH pads aren't reached.
+  std::vector<uint64_t> longest(bool normal, const llvm::BitVector &throws,
+                                std::vector<uint32_t> &why) {
+    DenseGraph graph(blocks.size());
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+      if (normal && throws.test(b)) {
+        continue;
+      }
+      for (const llvm::BasicBlock *successor : llvm::successors(blocks[b])) {
+        const llvm::Loop *loop = LI.getLoopFor(successor);
+        const bool back_edge = loop != nullptr &&
+                               loop->getHeader() == successor &&
+                               loop->contains(blocks[b]);
+        if (!back_edge && !(normal && successor->isEHPad())) {
+          graph.add_edge(b, ordinals.lookup(successor));
+        }
+      }
+    }
+    graph.finish();
+
+    // Each block is done once everything after it is. Blocks that never
+    // get there are on (or lead to) a cycle that isn't a loop.
+    std::vector<uint64_t> value(blocks.size(), MaxCostLattice::kUnbounded);
+    why.assign(blocks.size(), kNoReason);
+    std::vector<uint32_t> pending(blocks.size());
+    std::vector<uint32_t> ready;
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+      pending[b] = graph.successors(b).size();
+      if (pending[b] == 0) {
+        ready.push_back(b);
+      }
+    }
+    while (!ready.empty()) {
+      const uint32_t b = ready.back();
+      ready.pop_back();
+      uint64_t after = MaxCostLattice::bottom();
+      why[b] = local_reason[b];
+      for (uint32_t successor : graph.successors(b)) {
+        after = MaxCostLattice::join(after, value[successor]);
+        if (why[b] == kNoReason) {
+          why[b] = why[successor];
+        }
+      }
+      value[b] = MaxCostLattice::transfer(local[b], after);
+      for (uint32_t predecessor : graph.predecessors(b)) {
+        if (--pending[predecessor] == 0) {
+          ready.push_back(predecessor);
+        }
+      }
+    }
+    for (uint32_t b = 0; b < blocks.size(); ++b) {
+      if (pending[b] != 0) {
+        if (irreducible == kNoReason) {
+          irreducible = reason("control flow in " +
+                               demangled_name(F.getName()).str() +
+                               " that cycles without a loop");
+        }
+        why[b] = irreducible;
+      }
+    }
+    return value;
+  }
+
+private:
+  uint32_t reason(std::string text) {
+    reasons.push_back(std::move(text));
+    return reasons.size() - 1;
+  }
+
+  const llvm::Function &F;
+  const llvm::LoopInfo &LI;
+  std::vector<const llvm::BasicBlock *> blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, uint32_t> ordinals;
+  std::vector<std::string> reasons;
+  uint32_t irreducible = kNoReason;
+  // The product of the trip bounds of the loops around each block, or
+  // kUnbounded if one of them has none.
+  std::vector<uint64_t> trips;
+  std::vector<uint32_t> trips_reason;
+  std::vector<uint64_t> local;
+  std::vector<uint32_t> local_reason;
+};
+
+// "recursion through f, g": why a recursive group has no bound.
+std::string recursion_through(const CallGroups::Group &group) {
+  std::string text = "recursion through ";
+  for (const llvm::Function *member : group.members) {
+    text += (member == group.members.front() ? "" : ", ");
+    text += demangled_name(member->getName());
+  }
+  return text;
+}
+
+// How many frames of a recursive group one call into it may make, if
+// RecursionBounds has a bound on its depth; for the costs that add up over
+// every frame (cycles, slow calls), which are then the worst member's, with
+// its direct calls back into the group left out, times this.
+//
+// With at most `fan_out` calls back along any path through a frame, that's
+// 1 + fan_out + ... + fan_out^(depth - 1) frames. The bound is for one
+// call-graph SCC, so it doesn't cover a group that indirect calls made
+// bigger.
+std::optional<uint64_t> recursionFrames(const CallGroups::Group &group,
+                                        const RecursionBounds &bounds,
+                                        llvm::FunctionAnalysisManager &FAM) {
+  const std::optional<RecursionBound> *bound =
+      bounds.lookup(group.members.front());
+  if (bound == nullptr || !bound->has_value() ||
+      !llvm::all_of(group.members, [&](const llvm::Function *F) {
+        return bounds.lookup(F) == bound;
+      })) {
+    return std::nullopt;
+  }
+  uint64_t fan_out = 0;
+  for (const llvm::Function *F : group.members) {
+    PathCosts paths(*F, FAM.getResult<llvm::LoopAnalysis>(
+                            const_cast<llvm::Function &>(*F)),
+                    FAM.getResult<llvm::ScalarEvolutionAnalysis>(
+                        const_cast<llvm::Function &>(*F)));
+    for (uint32_t b = 0; b < paths.size(); ++b) {
+      uint64_t calls = 0;
+      for (const llvm::Instruction &I : *paths.block(b)) {
+        const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+        calls += call != nullptr &&
+                 llvm::is_contained(group.members, call->getCalledFunction());
+      }
+      paths.add(b, calls);
+    }
+    std::vector<uint32_t> why;
+    const llvm::BitVector no_throws(paths.size());
+    fan_out = std::max(
+        fan_out, paths.longest(/*normal=*/false, no_throws, why)[0]);
+  }
+  if (fan_out <= 1) {
+    return (*bound)->depth;
+  }
+  uint64_t frames = 0;
+  for (uint64_t level = 1, d = 0;
+       d < (*bound)->depth && frames != MaxCostLattice::kUnbounded;
+       ++d, level = llvm::SaturatingMultiply(level, fan_out)) {
+    frames = MaxCostLattice::transfer(frames, level);
+  }
+  return frames;
+}
+
+// Estimated worst-case cycles for `F`: each block's instructions, and the
+// calls they make, along the longest path; see PathCosts. `costs` has the
+// callees done so far: a callee that isn't there yet is on a cycle of
+// calls. Direct calls to the members of `group` are free; see
+// recursionFrames.
+CycleCost functionCycles(llvm::Function &F, llvm::FunctionAnalysisManager &FAM,
+                         CycleModel &model, const IndirectCallTargets &targets,
+                         const CycleCosts &costs,
+                         llvm::ArrayRef<const llvm::Function *> group = {}) {
+  const llvm::TargetTransformInfo &TTI =
+      FAM.getResult<llvm::TargetIRAnalysis>(F);
+  const uint32_t target = model.target(F);
+  PathCosts paths(F, FAM.getResult<llvm::LoopAnalysis>(F),
+                  FAM.getResult<llvm::ScalarEvolutionAnalysis>(F));
+  CycleCost result;
+
+  llvm::BitVector throws(paths.size());
+  auto call_cost = [&](uint32_t b, const llvm::Function *callee) {
+    if (callee->isDeclaration()) {
+      result.calls_unknown |= !callee->isIntrinsic();
+      return uint64_t(0);
+    }
+    auto it = costs.functions.find(callee);
+    if (it == costs.functions.end()) {
+      paths.add_unbounded(b, "recursion through an indirect call to " +
+                                 demangled_name(callee->getName()).str());
+      return uint64_t(0);
+    }
+    result.calls_unknown |= it->second.calls_unknown;
+    if (!it->second.unbounded.empty()) {
+      paths.add_unbounded(b, it->second.unbounded);
+    }
+    return it->second.cycles;
+  };
+  for (uint32_t b = 0; b < paths.size(); ++b) {
+    uint64_t cycles = 0;
+    for (const llvm::Instruction &I : *paths.block(b)) {
+      cycles = MaxCostLattice::transfer(cycles, model.cost(target, I, TTI));
+      const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+      if (call == nullptr || call->isInlineAsm()) {
+        continue;
+      }
+      if (const llvm::Function *callee = call->getCalledFunction()) {
+        throws[b] = throws[b] || is_throw(callee);
+        if (llvm::is_contained(group, callee)) {
+          continue;
+        }
+        cycles = MaxCostLattice::transfer(cycles, call_cost(b, callee));
+        continue;
+      }
+      std::optional<uint32_t> set = targets.lookup(*call);
+      if (!set) {
+        result.calls_unknown = true;
+        continue;
+      }
+      uint64_t worst = 0;
+      for (const llvm::Function *candidate : targets.sets[*set]) {
+        worst = MaxCostLattice::join(worst, call_cost(b, candidate));
+      }
+      cycles = MaxCostLattice::transfer(cycles, worst);
+    }
+    // Even a block TTI says is free takes a cycle, so a loop with no bound
+    // never is.
+    paths.add(b, std::max<uint64_t>(cycles, 1));
+  }
+
+  std::vector<uint32_t> why;
+  const std::vector<uint64_t> value =
+      paths.longest(/*normal=*/false, throws, why);
+  result.cycles = value[0];
+  if (why[0] != PathCosts::kNoReason) {
+    result.unbounded = paths.reason(why[0]);
+  }
+
+  // With exception handling, the same split as the verdicts: up to a
+  // return or a throw, and from the landing pads on.
+  std::vector<uint32_t> pads;
+  for (uint32_t b = 0; b < paths.size(); ++b) {
+    if (paths.block(b)->isEHPad()) {
+      pads.push_back(b);
+    }
+  }
+  if (!pads.empty() || throws.any()) {
+    std::vector<uint32_t> normal_why;
+    result.normal = paths.longest(/*normal=*/true, throws, normal_why)[0];
+    if (!pads.empty()) {
+      result.unwind = MaxCostLattice::bottom();
+      for (uint32_t pad : pads) {
+        result.unwind = MaxCostLattice::join(*result.unwind, value[pad]);
+      }
+    }
+  }
+  return result;
+}
+
+// The slow calls counted without -bounded-termination-slow-calls. Names are
+// mangled or demangled; a trailing '*' matches any rest of the name.
+constexpr std::pair<SlowCallKind, const char *> kSlowCalls[] = {
+    {SlowCallKind::Allocation, "malloc"},
+    {SlowCallKind::Allocation, "calloc"},
+    {SlowCallKind::Allocation, "realloc"},
+    {SlowCallKind::Allocation, "reallocarray"},
+    {SlowCallKind::Allocation, "free"},
+    {SlowCallKind::Allocation, "aligned_alloc"},
+    {SlowCallKind::Allocation, "posix_memalign"},
+    {SlowCallKind::Allocation, "memalign"},
+    {SlowCallKind::Allocation, "strdup"},
+    {SlowCallKind::Allocation, "strndup"},
+    {SlowCallKind::Allocation, "mmap"},
+    {SlowCallKind::Allocation, "munmap"},
+    {SlowCallKind::Allocation, "operator new*"},
+    {SlowCallKind::Allocation, "operator delete*"},
+    {SlowCallKind::Lock, "pthread_mutex_lock"},
+    {SlowCallKind::Lock, "pthread_mutex_timedlock"},
+    {SlowCallKind::Lock, "pthread_rwlock_rdlock"},
+    {SlowCallKind::Lock, "pthread_rwlock_wrlock"},
+    {SlowCallKind::Lock, "pthread_spin_lock"},
+    {SlowCallKind::Lock, "pthread_cond_wait"},
+    {SlowCallKind::Lock, "pthread_cond_timedwait"},
+    {SlowCallKind::Lock, "pthread_join"},
+    {SlowCallKind::Lock, "sem_wait"},
+    {SlowCallKind::Lock, "sem_timedwait"},
+    {SlowCallKind::Lock, "std::mutex::lock*"},
+    {SlowCallKind::Lock, "std::__1::mutex::lock*"},
+    {SlowCallKind::Logging, "printf"},
+    {SlowCallKind::Logging, "fprintf"},
+    {SlowCallKind::Logging, "dprintf"},
+    {SlowCallKind::Logging, "vprintf"},
+    {SlowCallKind::Logging, "vfprintf"},
+    {SlowCallKind::Logging, "__printf_chk"},
+    {SlowCallKind::Logging, "__fprintf_chk"},
+    {SlowCallKind::Logging, "puts"},
+    {SlowCallKind::Logging, "fputs"},
+    {SlowCallKind::Logging, "putchar"},
+    {SlowCallKind::Logging, "perror"},
+    {SlowCallKind::Logging, "syslog"},
+    {SlowCallKind::Logging, "vsyslog"},
+    {SlowCallKind::IO, "read"},
+    {SlowCallKind::IO, "write"},
+    {SlowCallKind::IO, "pread"},
+    {SlowCallKind::IO, "pwrite"},
+    {SlowCallKind::IO, "open"},
+    {SlowCallKind::IO, "close"},
+    {SlowCallKind::IO, "ioctl"},
+    {SlowCallKind::IO, "fsync"},
+    {SlowCallKind::IO, "poll"},
+    {SlowCallKind::IO, "select"},
+    {SlowCallKind::IO, "recv"},
+    {SlowCallKind::IO, "send"},
+    {SlowCallKind::IO, "recvfrom"},
+    {SlowCallKind::IO, "sendto"},
+    {SlowCallKind::IO, "fopen"},
+    {SlowCallKind::IO, "fclose"},
+    {SlowCallKind::IO, "fread"},
+    {SlowCallKind::IO, "fwrite"},
+    {SlowCallKind::IO, "fflush"},
+    {SlowCallKind::IO, "fgets"},
+    {SlowCallKind::IO, "getchar"},
+    {SlowCallKind::IO, "scanf"},
+};
+
+// Which functions are slow calls, and of what kind.
+class SlowCallCatalog {
+public:
+  void add(SlowCallKind kind, llvm::StringRef name) {
+    if (name.consume_back("*")) {
+      prefixes.push_back({name.str(), kind});
+    } else {
+      names.try_emplace(name, kind);
+    }
+  }
+
+  std::optional<SlowCallKind> lookup(const llvm::Function &F) const {
+    // Only demangle what might be mangled.
+    llvm::StringRef name = F.getName();
+    for (int pass = 0; pass < 2; ++pass) {
+      if (auto it = names.find(name); it != names.end()) {
+        return it->second;
+      }
+      for (const auto &[prefix, kind] : prefixes) {
+        if (name.startswith(prefix)) {
+          return kind;
+        }
+      }
+      if (!name.startswith("_Z") && !name.startswith("?")) {
+        break;
+      }
+      name = demangled_name(name);
+    }
+    return std::nullopt;
+  }
+
+private:
+  llvm::StringMap<SlowCallKind> names;
+  std::vector<std::pair<std::string, SlowCallKind>> prefixes;
+};
+
+// Reads more of the catalog from -bounded-termination-slow-calls:
+// "<kind> <name>" lines, with '#' starting a comment.
+llvm::Error read_slow_calls(const std::string &path,
+                            SlowCallCatalog &catalog) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer) {
+    return llvm::createStringError(buffer.getError(), "can't read %s: %s",
+                                   path.c_str(),
+                                   buffer.getError().message().c_str());
+  }
+  for (llvm::line_iterator line(**buffer, /*SkipBlanks=*/true, '#');
+       !line.is_at_eof(); ++line) {
+    auto [kind, name] = llvm::StringRef(*line).trim().split(' ');
+    std::optional<SlowCallKind> parsed;
+    for (size_t k = 0; k < kSlowCallKinds; ++k) {
+      if (kind == to_string(SlowCallKind(k))) {
+        parsed = SlowCallKind(k);
+      }
+    }
+    name = name.trim();
+    if (!parsed || name.empty()) {
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(), "%s:%d: not \"<kind> <name>\"",
+          path.c_str(), int(line.line_number()));
+    }
+    catalog.add(*parsed, name);
+  }
+  return llvm::Error::success();
+}
+
+// The slow calls `F` may make, of the kinds in `reaches` (bits by
+// SlowCallKind); see PathCosts. `counts` has the callees done so far. A
+// callee that isn't there either makes none, or is on a cycle of calls
+// (a call to a group no earlier than `F`'s in `call_groups.order`). Direct
+// calls to the members of `group` are free; see recursionFrames.
+SlowCalls functionSlowCalls(
+    llvm::Function &F, llvm::FunctionAnalysisManager &FAM, uint8_t reaches,
+    const llvm::DenseMap<const llvm::Function *, SlowCallKind> &catalogued,
+    const std::vector<uint8_t> &group_reaches, const CallGroups &call_groups,
+    const IndirectCallTargets &targets, const SlowCallCounts &counts,
+    llvm::ArrayRef<const llvm::Function *> group = {}) {
+  PathCosts paths(F, FAM.getResult<llvm::LoopAnalysis>(F),
+                  FAM.getResult<llvm::ScalarEvolutionAnalysis>(F));
+  const uint32_t position =
+      call_groups.position[call_groups.group_of.lookup(&F)];
+  const llvm::BitVector no_throws(paths.size());
+  SlowCalls result;
+  for (size_t k = 0; k < kSlowCallKinds; ++k) {
+    if ((reaches & (1u << k)) == 0) {
+      continue;
+    }
+    SlowCalls::Count &count = result.kinds[k];
+    auto calls_to = [&](uint32_t b, const llvm::Function *callee) {
+      uint64_t calls = 0;
+      if (auto it = catalogued.find(callee);
+          it != catalogued.end() && size_t(it->second) == k) {
+        calls = 1;
+        count.example = count.example ? count.example : callee;
+      }
+      auto it = counts.functions.find(callee);
+      if (it == counts.functions.end()) {
+        const uint32_t g = call_groups.group_of.lookup(callee);
+        if (!callee->isDeclaration() && call_groups.position[g] >= position &&
+            (group_reaches[g] & (1u << k)) != 0) {
+          paths.add_unbounded(b, "recursion through an indirect call to " +
+                                     demangled_name(callee->getName()).str());
+        }
+        return calls;
+      }
+      const SlowCalls::Count &below = it->second.kinds[k];
+      count.example = count.example ? count.example : below.example;
+      if (!below.unbounded.empty()) {
+        paths.add_unbounded(b, below.unbounded);
+        return calls;
+      }
+      return MaxCostLattice::transfer(calls, below.calls);
+    };
+
+    paths.clear();
+    for (uint32_t b = 0; b < paths.size(); ++b) {
+      uint64_t amount = 0;
+      for (const llvm::Instruction &I : *paths.block(b)) {
+        const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+        if (call == nullptr || call->isInlineAsm()) {
+          continue;
+        }
+        if (const llvm::Function *callee = call->getCalledFunction()) {
+          if (!llvm::is_contained(group, callee)) {
+            amount = MaxCostLattice::transfer(amount, calls_to(b, callee));
+          }
+          continue;
+        }
+        std::optional<uint32_t> set = targets.lookup(*call);
+        if (!set) {
+          continue;
+        }
+        uint64_t worst = 0;
+        for (const llvm::Function *candidate : targets.sets[*set]) {
+          worst = MaxCostLattice::join(worst, calls_to(b, candidate));
+        }
+        amount = MaxCostLattice::transfer(amount, worst);
+      }
+      paths.add(b, amount);
+    }
+    std::vector<uint32_t> why;
+    count.calls = paths.longest(/*normal=*/false, no_throws, why)[0];
+    if (why[0] != PathCosts::kNoReason) {
+      count.unbounded = paths.reason(why[0]);
+    }
+  }
+  return result;
+}
+
+// Serializes what a function's results depend on, for hashing: its code,
+// attributes and attached metadata, by content. Nothing in it is numbered
+// module-wide (metadata, attribute groups), so an edit to one function
+// doesn't move the others' fingerprints.
+class FunctionFingerprinter {
+public:
+  explicit FunctionFingerprinter(const llvm::Module &M) : os(text) {
+    M.getContext().getMDKindNames(kind_names);
+  }
+
+  uint64_t fingerprint(const llvm::Function &F) {
+    text.clear();
+    ordinals.clear();
+    nodes.clear();
+    for (const llvm::BasicBlock &block : F) {
+      ordinals.insert({&block, ordinals.size()});
+      for (const llvm::Instruction &I : block) {
+        if (!llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+          ordinals.insert({&I, ordinals.size()});
+        }
+      }
+    }
+
+    add(F.getFunctionType());
+    os << "L" << F.getLinkage() << "C" << F.getCallingConv();
+    add(F.getAttributes(), F.arg_size());
+    if (F.hasPersonalityFn()) {
+      add(F.getPersonalityFn());
+    }
+    add_metadata(F);
+    for (const llvm::BasicBlock &block : F) {
+      os << "B";
+      for (const llvm::Instruction &I : block) {
+        if (!llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+          add(I);
+        }
+      }
+    }
+    os.flush();
+    return llvm::xxHash64(text);
+  }
+
+private:
+  void add(llvm::StringRef string) { os << string.size() << ":" << string; }
+  void add(const llvm::Type *type) {
+    os << "t";
+    type->print(os);
+  }
+  void add(const llvm::AttributeList &attributes, unsigned arguments) {
+    os << "A";
+    add(attributes.getFnAttrs().getAsString());
+    add(attributes.getRetAttrs().getAsString());
+    for (unsigned i = 0; i < arguments; ++i) {
+      add(attributes.getParamAttrs(i).getAsString());
+    }
+  }
+
+  void add(const llvm::Instruction &I) {
+    os << "I" << I.getOpcode() << "," << I.getRawSubclassOptionalData();
+    add(I.getType());
+    if (const auto *compare = llvm::dyn_cast<llvm::CmpInst>(&I)) {
+      os << "p" << compare->getPredicate();
+    } else if (const auto *load = llvm::dyn_cast<llvm::LoadInst>(&I)) {
+      os << "m" << load->isVolatile() << int(load->getOrdering())
+         << llvm::Log2(load->getAlign());
+    } else if (const auto *store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+      os << "m" << store->isVolatile() << int(store->getOrdering())
+         << llvm::Log2(store->getAlign());
+    } else if (const auto *rmw = llvm::dyn_cast<llvm::AtomicRMWInst>(&I)) {
+      os << "m" << rmw->isVolatile() << int(rmw->getOrdering())
+         << int(rmw->getOperation());
+    } else if (const auto *cas = llvm::dyn_cast<llvm::AtomicCmpXchgInst>(&I)) {
+      os << "m" << cas->isVolatile() << cas->isWeak()
+         << int(cas->getSuccessOrdering()) << int(cas->getFailureOrdering());
+    } else if (const auto *fence = llvm::dyn_cast<llvm::FenceInst>(&I)) {
+      os << "m" << int(fence->getOrdering());
+    } else if (const auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&I)) {
+      add(alloca->getAllocatedType());
+    } else if (const auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&I)) {
+      add(gep->getSourceElementType());
+    } else if (const auto *call = llvm::dyn_cast<llvm::CallBase>(&I)) {
+      os << "c" << call->getCallingConv();
+      add(call->getFunctionType());
+      add(call->getAttributes(), call->arg_size());
+      if (const auto *plain = llvm::dyn_cast<llvm::CallInst>(call)) {
+        os << "k" << plain->getTailCallKind();
+      }
+      for (unsigned i = 0; i < call->getNumOperandBundles(); ++i) {
+        add(call->getOperandBundleAt(i).getTagName());
+      }
+    } else if (const auto *phi = llvm::dyn_cast<llvm::PHINode>(&I)) {
+      for (const llvm::BasicBlock *incoming : phi->blocks()) {
+        add(incoming);
+      }
+    } else if (const auto *shuffle =
+                   llvm::dyn_cast<llvm::ShuffleVectorInst>(&I)) {
+      for (int element : shuffle->getShuffleMask()) {
+        os << "s" << element;
+      }
+    } else if (const auto *extract =
+                   llvm::dyn_cast<llvm::ExtractValueInst>(&I)) {
+      for (unsigned index : extract->indices()) {
+        os << "x" << index;
+      }
+    } else if (const auto *insert = llvm::dyn_cast<llvm::InsertValueInst>(&I)) {
+      for (unsigned index : insert->indices()) {
+        os << "x" << index;
+      }
+    } else if (const auto *pad = llvm::dyn_cast<llvm::LandingPadInst>(&I)) {
+      os << "l" << pad->isCleanup();
+    }
+    for (const llvm::Value *operand : I.operands()) {
+      add(operand);
+    }
+    add_metadata(I);
+  }
+
+  void add(const llvm::Value *value) {
+    if (auto it = ordinals.find(value); it != ordinals.end()) {
+      os << "v" << it->second;
+    } else if (const auto *argument = llvm::dyn_cast<llvm::Argument>(value)) {
+      os << "a" << argument->getArgNo();
+    } else if (const auto *global = llvm::dyn_cast<llvm::GlobalValue>(value)) {
+      os << "g" << global->getValueID();
+      add(global->getName());
+    } else if (const auto *as_value =
+                   llvm::dyn_cast<llvm::MetadataAsValue>(value)) {
+      add(as_value->getMetadata());
+    } else if (const auto *asm_ = llvm::dyn_cast<llvm::InlineAsm>(value)) {
+      os << "s" << asm_->hasSideEffects();
+      add(asm_->getAsmString());
+      add(asm_->getConstraintString());
+    } else if (const auto *integer = llvm::dyn_cast<llvm::ConstantInt>(value)) {
+      add(integer->getType());
+      os << "i" << llvm::toString(integer->getValue(), 16, /*Signed=*/false);
+    } else if (const auto *real = llvm::dyn_cast<llvm::ConstantFP>(value)) {
+      add(real->getType());
+      os << "f"
+         << llvm::toString(real->getValueAPF().bitcastToAPInt(), 16,
+                           /*Signed=*/false);
+    } else if (const auto *data =
+                   llvm::dyn_cast<llvm::ConstantDataSequential>(value)) {
+      add(data->getType());
+      add(data->getRawDataValues());
+    } else if (const auto *constant = llvm::dyn_cast<llvm::Constant>(value)) {
+      // Aggregates, expressions, null, undef, ...: their kind and parts.
+      os << "k" << constant->getValueID();
+      add(constant->getType());
+      if (const auto *expression =
+              llvm::dyn_cast<llvm::ConstantExpr>(constant)) {
+        os << "e" << expression->getOpcode();
+        if (expression->isCompare()) {
+          os << "p" << expression->getPredicate();
+        }
+      }
+      os << "(";
+      for (const llvm::Value *operand : constant->operands()) {
+        add(operand);
+      }
+      os << ")";
+    } else {
+      os << "?" << value->getValueID();
+    }
+  }
+
+  // Attachments, by kind name, except the location (see add(Metadata)).
+  template <typename T> void add_metadata(const T &holder) {
+    llvm::SmallVector<std::pair<unsigned, llvm::MDNode *>, 4> attached;
+    holder.getAllMetadata(attached);
+    for (const auto &[kind, node] : attached) {
+      if (kind == llvm::LLVMContext::MD_dbg) {
+        if constexpr (std::is_same_v<T, llvm::Instruction>) {
+          add(node);
+        }
+        continue;
+      }
+      add(kind < kind_names.size() ? kind_names[kind] : "");
+      add(node);
+    }
+  }
+
+  void add(const llvm::Metadata *metadata) {
+    if (metadata == nullptr) {
+      os << "n";
+    } else if (const auto *string = llvm::dyn_cast<llvm::MDString>(metadata)) {
+      os << "S";
+      add(string->getString());
+    } else if (const auto *as_metadata =
+                   llvm::dyn_cast<llvm::ValueAsMetadata>(metadata)) {
+      add(as_metadata->getValue());
+    } else if (const auto *location =
+                   llvm::dyn_cast<llvm::DILocation>(metadata)) {
+      // Where, for the report; not the scope, which leads to the whole
+      // compile unit.
+      os << "@" << location->getLine() << ":" << location->getColumn();
+      add(location->getFilename());
+      add(location->getInlinedAt());
+    } else if (const auto *expression =
+                   llvm::dyn_cast<llvm::DIExpression>(metadata)) {
+      for (uint64_t element : expression->getElements()) {
+        os << "E" << element;
+      }
+    } else if (const auto *debug = llvm::dyn_cast<llvm::DINode>(metadata)) {
+      // Debug info (variables, scopes, types) only by its name, for the
+      // same reason.
+      os << "D" << debug->getTag();
+      if (const auto *scope = llvm::dyn_cast<llvm::DIScope>(debug)) {
+        add(scope->getName());
+      } else if (const auto *variable =
+                     llvm::dyn_cast<llvm::DIVariable>(debug)) {
+        add(variable->getName());
+      }
+    } else if (const auto *node = llvm::dyn_cast<llvm::MDNode>(metadata)) {
+      // Loop metadata refers to itself.
+      auto [it, inserted] = nodes.insert({node, nodes.size()});
+      if (!inserted) {
+        os << "r" << it->second;
+        return;
+      }
+      os << "N" << node->getNumOperands() << "(";
+      for (const llvm::MDOperand &operand : node->operands()) {
+        add(operand.get());
+      }
+      os << ")";
+    } else {
+      os << "?" << unsigned(metadata->getMetadataID());
+    }
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os;
+  llvm::SmallVector<llvm::StringRef, 32> kind_names;
+  // Blocks and instructions of the function, by position.
+  llvm::DenseMap<const llvm::Value *, uint32_t> ordinals;
+  llvm::DenseMap<const llvm::MDNode *, uint32_t> nodes;
+};
+
+// Hashes of the code of each function in `M`: what their (contingent)
+// results depend on. Two parses of the same file agree on them for the
+// functions that didn't change, in any process, so they can be saved; and
+// an edit to one function doesn't change the others', with debug info or
+// profile metadata too.
+llvm::StringMap<uint64_t> function_fingerprints(const llvm::Module &M) {
+  FunctionFingerprinter fingerprinter(M);
+  llvm::StringMap<uint64_t> result;
+  for (const llvm::Function &F : M) {
+    result[F.getName()] = fingerprinter.fingerprint(F);
+  }
+  return result;
+}
+
+// `result`, for `to`: a fresh parse of the same code as `from`.
+// Its references to blocks of `from` move to the blocks in the same places.
+TerminationPassResult rebase(TerminationPassResult result,
+                             const llvm::Function &from,
+                             const llvm::Function &to) {
+  llvm::DenseMap<const llvm::BasicBlock *, const llvm::BasicBlock *> blocks;
+  for (auto &&[old_block, new_block] : llvm::zip(from, to)) {
+    blocks[&old_block] = &new_block;
+  }
+  for (ContendedLoop &contended : result.contended_loops) {
+    contended.header = blocks.lookup(contended.header);
+  }
+  for (ArgumentBoundedLoop &loop : result.argument_bounded_loops) {
+    loop.header = blocks.lookup(loop.header);
+    loop.exiting = blocks.lookup(loop.exiting);
+  }
+  for (LoopProfile &loop : result.loop_profiles) {
+    loop.header = blocks.lookup(loop.header);
+  }
+  return result;
+}
+
+// The options a saved result depends on; a baseline written with others
+// can't be compared function by function. (Profile counts only rank loops.)
+std::string baseline_settings() {
+  std::string settings = attribute_mode == AttributeMode::Trust
+                             ? "attributes=trust"
+                             : "attributes=verify";
+  settings += unwind_mode == UnwindMode::Join ? " unwind=join"
+                                              : " unwind=separate";
+  if (whole_program) {
+    settings += " whole-program";
+  }
+  return settings;
+}
+
+// What a function's saved result depends on, besides its callees: its code,
+// and how it's annotated.
+uint64_t baseline_fingerprint(const llvm::Function &F,
+                              const llvm::StringMap<uint64_t> &fingerprints,
+                              const TerminationAnnotations &annotations) {
+  std::string key = llvm::utohexstr(fingerprints.lookup(F.getName()));
+  if (annotations.assume_bounded.contains(&F)) {
+    key += " assume-bounded";
+  }
+  if (annotations.assume_unbounded.contains(&F)) {
+    key += " assume-unbounded";
+  }
+  return llvm::xxHash64(key);
+}
+
+std::optional<DoesThisTerminate> parse_verdict(llvm::StringRef text) {
+  for (DoesThisTerminate elt :
+       {DoesThisTerminate::Unevaluated, DoesThisTerminate::Bounded,
+        DoesThisTerminate::Unbounded, DoesThisTerminate::Unknown}) {
+    if (text == to_string(elt)) {
+      return elt;
+    }
+  }
+  return std::nullopt;
+}
+
+// Reads what BoundedTerminationBaselineWriter wrote.
+llvm::Expected<Baseline> read_baseline(const std::string &path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer) {
+    return llvm::createStringError(buffer.getError(), "can't read %s: %s",
+                                   path.c_str(),
+                                   buffer.getError().message().c_str());
+  }
+  Baseline baseline;
+  for (llvm::line_iterator line(**buffer, /*SkipBlanks=*/true);
+       !line.is_at_eof(); ++line) {
+    llvm::StringRef text = *line;
+    if (line.line_number() == 1 && text.consume_front("#")) {
+      baseline.settings = text.trim().str();
+      continue;
+    }
+    llvm::SmallVector<llvm::StringRef, 4> fields;
+    text.split(fields, '\t', /*MaxSplit=*/3);
+    std::optional<DoesThisTerminate> elt;
+    uint64_t fingerprint;
+    if (fields.size() == 4) {
+      elt = parse_verdict(fields[1]);
+    }
+    if (!elt || fields[2].getAsInteger(16, fingerprint)) {
+      return llvm::createStringError(
+          llvm::inconvertibleErrorCode(), "%s:%d: not a saved result",
+          path.c_str(), int(line.line_number()));
+    }
+    baseline.functions[fields[0]] = Baseline::Entry{
+        .elt = *elt,
+        .fingerprint = fingerprint,
+        .explanation = fields[3].str(),
+    };
+  }
+  return baseline;
+}
+
+// The functions in `IR` whose results can't have moved since `baseline`,
+// with their saved results: their code is the same, and so is the code of
+// everything they may call.
+ModuleTerminationPass::Pinned
+pin_unchanged(const llvm::Module &IR, const Baseline &baseline,
+              const TerminationAnnotations &annotations,
+              const llvm::CallGraph &CG, const IndirectCallTargets &targets) {
+  ModuleTerminationPass::Pinned pinned;
+  if (baseline.settings != baseline_settings()) {
+    return pinned;
+  }
+  const llvm::StringMap<uint64_t> fingerprints = function_fingerprints(IR);
+  // If a function went away, an indirect call may have lost a candidate.
+  bool removed = false;
+  for (const auto &entry : baseline.functions) {
+    removed |= IR.getFunction(entry.getKey()) == nullptr;
+  }
+
+  llvm::DenseMap<const llvm::Function *, std::vector<const llvm::Function *>>
+      callers, callees;
+  llvm::DenseSet<const llvm::Function *> changed;
+  std::vector<const llvm::Function *> worklist;
+  auto change = [&](const llvm::Function *F) {
+    if (changed.insert(F).second) {
+      worklist.push_back(F);
+    }
+  };
+  for (const llvm::Function &F : IR) {
+    auto call = [&](const llvm::Function *callee) {
+      callers[callee].push_back(&F);
+      callees[&F].push_back(callee);
+    };
+    for (const auto &record : *CG[&F]) {
+      if (const llvm::Function *callee = record.second->getFunction()) {
+        call(callee);
+        continue;
+      }
+      const llvm::CallBase *site = call_of(record);
+      if (site == nullptr || !site->isIndirectCall()) {
+        continue;
+      }
+      if (removed) {
+        change(&F);
+      }
+      if (std::optional<uint32_t> set = targets.lookup(*site)) {
+        llvm::for_each(targets.sets[*set], call);
+      }
+    }
+    auto saved = baseline.functions.find(F.getName());
+    if (!F.hasName() || saved == baseline.functions.end() ||
+        saved->second.fingerprint !=
+            baseline_fingerprint(F, fingerprints, annotations)) {
+      change(&F);
+    }
+  }
+  // A change reaches everything that may call it...
+  while (!worklist.empty()) {
+    const llvm::Function *F = worklist.back();
+    worklist.pop_back();
+    for (const llvm::Function *caller : callers[F]) {
+      change(caller);
+    }
+  }
+  // ...and a caller that's analyzed again needs the summaries of what it
+  // calls (argument-bounded loops), which aren't saved. Only a result that's
+  // Bounded outright doesn't have one.
+  llvm::DenseSet<const llvm::Function *> unpinned = changed;
+  worklist.assign(changed.begin(), changed.end());
+  while (!worklist.empty()) {
+    const llvm::Function *F = worklist.back();
+    worklist.pop_back();
+    for (const llvm::Function *callee : callees[F]) {
+      if (baseline.functions.lookup(callee->getName()).elt !=
+              DoesThisTerminate::Bounded &&
+          unpinned.insert(callee).second) {
+        worklist.push_back(callee);
+      }
+    }
+  }
+
+  for (const llvm::Function &F : IR) {
+    if (unpinned.contains(&F)) {
+      continue;
+    }
+    const Baseline::Entry &saved = baseline.functions.find(F.getName())->second;
+    // Not analyzed last time; whether it is now is up to its callers.
+    if (saved.elt == DoesThisTerminate::Unevaluated) {
+      continue;
+    }
+    pinned.insert({&F, TerminationPassResult{
+                           .elt = saved.elt,
+                           .explanation = saved.explanation,
+                       }});
+  }
+  return pinned;
+}
+
+llvm::PassPluginLibraryInfo getBoundedTerminationPassPluginInfo();
+
+//------------------------------------------------------------------------------
+// Pass bodies
+//------------------------------------------------------------------------------
+
+TerminationAnnotationsAnalysis::Result
+TerminationAnnotationsAnalysis::run(llvm::Module &IR,
+                                    llvm::ModuleAnalysisManager &) {
+  TerminationAnnotations result;
+  const llvm::GlobalVariable *annotations =
+      IR.getGlobalVariable("llvm.global.annotations");
+  if (annotations == nullptr || !annotations->hasInitializer()) {
+    return result;
+  }
+  const auto *entries =
+      llvm::dyn_cast<llvm::ConstantArray>(annotations->getInitializer());
+  if (entries == nullptr) {
+    return result;
+  }
+  // Each entry is { annotated value, annotation string, file, line, args }.
+  for (const llvm::Use &use : entries->operands()) {
+    const auto *entry = llvm::dyn_cast<llvm::ConstantStruct>(use.get());
+    if (entry == nullptr || entry->getNumOperands() < 2) {
+      continue;
+    }
+    const auto *F = llvm::dyn_cast<llvm::Function>(
+        entry->getOperand(0)->stripPointerCasts());
+    const auto *annotation = llvm::dyn_cast<llvm::GlobalVariable>(
+        entry->getOperand(1)->stripPointerCasts());
+    if (F == nullptr || annotation == nullptr ||
+        !annotation->hasInitializer()) {
+      continue;
+    }
+    const auto *text = llvm::dyn_cast<llvm::ConstantDataSequential>(
+        annotation->getInitializer());
+    if (text == nullptr || !text->isCString()) {
+      continue;
+    }
+    const llvm::StringRef name = text->getAsCString();
+    if (name == "assume-bounded") {
+      result.assume_bounded.insert(F);
+    } else if (name == "assume-unbounded") {
+      result.assume_unbounded.insert(F);
+    } else if (name == "must-be-bounded") {
+      result.must_be_bounded.insert(F);
+    }
+  }
+  return result;
+}
+
+IndirectCallTargetsAnalysis::Result
+IndirectCallTargetsAnalysis::run(llvm::Module &IR,
+                                 llvm::ModuleAnalysisManager &) {
+  IndirectCallTargets targets;
+  auto set_for = [&](auto &index, const auto *key) -> auto & {
+    auto [it, inserted] = index.insert({key, targets.sets.size()});
+    if (inserted) {
+      targets.sets.emplace_back();
+    }
+    return targets.sets[it->second];
+  };
+  llvm::SmallVector<llvm::MDNode *, 2> types;
+  for (const llvm::Function &F : IR) {
+    if (F.hasAddressTaken()) {
+      set_for(targets.by_signature, F.getFunctionType()).push_back(&F);
+      types.clear();
+      F.getMetadata(llvm::LLVMContext::MD_type, types);
+      for (const llvm::MDNode *type : types) {
+        // !{i64 offset, !"identifier"}
+        if (type->getNumOperands() == 2) {
+          set_for(targets.by_type_id, type->getOperand(1).get()).push_back(&F);
+        }
+      }
+    }
+    for (const llvm::BasicBlock &BB : F) {
+      for (const llvm::Instruction &I : BB) {
+        const llvm::MDNode *callees =
+            I.getMetadata(llvm::LLVMContext::MD_callees);
+        if (callees == nullptr || targets.by_callees.count(callees)) {
+          continue;
+        }
+        auto &set = set_for(targets.by_callees, callees);
+        for (const llvm::MDOperand &op : callees->operands()) {
+          if (const auto *callee =
+                  llvm::mdconst::dyn_extract_or_null<llvm::Function>(op)) {
+            set.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+  return targets;
+}
+
+std::optional<uint32_t>
+IndirectCallTargets::lookup(const llvm::CallBase &call) const {
+  if (const llvm::MDNode *callees =
+          call.getMetadata(llvm::LLVMContext::MD_callees)) {
+    return by_callees.lookup(callees);
+  }
+  // Under CFI, the called pointer is checked against a type identifier first
+  // (possibly through a cast, with typed pointers).
+  llvm::SmallVector<const llvm::User *, 8> users(
+      call.getCalledOperand()->users());
+  while (!users.empty()) {
+    const llvm::User *user = users.pop_back_val();
+    if (llvm::isa<llvm::BitCastInst>(user)) {
+      users.append(user->user_begin(), user->user_end());
+      continue;
+    }
+    const auto *test = llvm::dyn_cast<llvm::IntrinsicInst>(user);
+    if (test == nullptr ||
+        test->getIntrinsicID() != llvm::Intrinsic::type_test) {
+      continue;
+    }
+    const llvm::Metadata *id =
+        llvm::cast<llvm::MetadataAsValue>(test->getArgOperand(1))
+            ->getMetadata();
+    if (auto it = by_type_id.find(id); it != by_type_id.end()) {
+      return it->second;
+    }
+  }
+  // Otherwise the pointer may have come from another translation unit, or a
+  // library, unless there are none.
+  if (!whole_program) {
+    return std::nullopt;
+  }
+  // No address-taken function has the type: the pointer came from outside.
+  if (auto it = by_signature.find(call.getFunctionType());
+      it != by_signature.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+RecursionBoundsAnalysis::Result
+RecursionBoundsAnalysis::run(llvm::Module &IR,
+                             llvm::ModuleAnalysisManager &AM) {
+  auto &FAM =
+      AM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(IR).getManager();
+  llvm::CallGraph &CG = AM.getResult<llvm::CallGraphAnalysis>(IR);
+  RecursionBounds bounds;
+  for (llvm::scc_iterator<llvm::CallGraph *> SCCI = llvm::scc_begin(&CG);
+       !SCCI.isAtEnd(); ++SCCI) {
+    if (!SCCI.hasCycle()) {
+      continue;
+    }
+    // Groups that go through a call we can't see (the null node) can't be
+    // bounded here.
+    std::vector<llvm::Function *> scc;
+    bool closed = true;
+    for (llvm::CallGraphNode *node : *SCCI) {
+      llvm::Function *F = node->getFunction();
+      if (F == nullptr || F->isDeclaration()) {
+        closed = false;
+      } else {
+        scc.push_back(F);
+      }
+    }
+    std::optional<RecursionBound> bound;
+    if (closed) {
+      size_t arguments = scc.front()->arg_size();
+      for (const llvm::Function *F : scc) {
+        arguments = std::min(arguments, F->arg_size());
+      }
+      for (unsigned k = 0; k < arguments && !bound; ++k) {
+        bound = measureClassifier(scc, k, FAM);
+      }
+    }
+    for (const llvm::Function *F : scc) {
+      bounds.scc_of.insert({F, bounds.sccs.size()});
+    }
+    bounds.sccs.push_back(bound);
+  }
+  return bounds;
+}
+
+CallGroupsAnalysis::Result
+CallGroupsAnalysis::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
+  llvm::CallGraph &CG = AM.getResult<llvm::CallGraphAnalysis>(IR);
+  const IndirectCallTargets &targets =
+      AM.getResult<IndirectCallTargetsAnalysis>(IR);
+  CallGroups result;
+
+  // Each SCC of the call graph is a group. Functions the walk from outside
+  // the module doesn't reach get walks of their own, which skip the groups
+  // already found.
+  auto add_groups = [&](auto SCCI) {
+    for (; !SCCI.isAtEnd(); ++SCCI) {
+      CallGroups::Group group;
+      for (llvm::CallGraphNode *node : *SCCI) {
+        if (const llvm::Function *F = node->getFunction()) {
+          group.members.push_back(F);
+          group.calls_unknown |= F->isDeclaration();
+        }
+      }
+      if (group.members.empty() ||
+          result.group_of.count(group.members.front())) {
+        continue;
+      }
+      for (const llvm::Function *F : group.members) {
+        result.group_of.insert({F, result.groups.size()});
+      }
+      group.recursive = SCCI.hasCycle();
+      result.groups.push_back(std::move(group));
+    }
+  };
+  add_groups(llvm::scc_begin(&CG));
+  for (const llvm::Function &F : IR) {
+    if (!result.group_of.count(&F)) {
+      add_groups(llvm::scc_begin(CG[&F]));
+    }
+  }
+
+  // Calls between groups, including the candidates of indirect calls.
+  const uint32_t size = result.groups.size();
+  DenseGraph calls(size);
+  llvm::DenseSet<const llvm::Function *> called;
+  for (uint32_t g = 0; g < size; ++g) {
+    CallGroups::Group &group = result.groups[g];
+    for (const llvm::Function *F : group.members) {
+      for (const auto &record : *CG[F]) {
+        if (const llvm::Function *callee = record.second->getFunction()) {
+          called.insert(callee);
+          const uint32_t to = result.group_of.lookup(callee);
+          if (to != g) {
+            calls.add_edge(g, to);
+          }
+          continue;
+        }
+        const llvm::CallBase *call = call_of(record);
+        std::optional<uint32_t> set;
+        if (call != nullptr && call->isIndirectCall()) {
+          set = targets.lookup(*call);
+        }
+        if (!set) {
+          group.calls_unknown = true;
+          continue;
+        }
+        // Even within the group: recursion through a pointer isn't bounded.
+        for (const llvm::Function *candidate : targets.sets[*set]) {
+          called.insert(candidate);
+          calls.add_edge(g, result.group_of.lookup(candidate));
+        }
+      }
+    }
+  }
+  calls.finish();
+  result.calls = std::move(calls);
+  for (const llvm::Function &F : IR) {
+    if (!F.isDeclaration() && !called.contains(&F)) {
+      result.roots.push_back(&F);
+    }
+  }
+
+  // Post-order, by a depth-first walk over the calls.
+  llvm::BitVector visited(size);
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  result.position.assign(size, 0);
+  for (uint32_t start = 0; start < size; ++start) {
+    if (visited.test(start)) {
+      continue;
+    }
+    visited.set(start);
+    stack.push_back({start, 0});
+    while (!stack.empty()) {
+      auto &[g, next] = stack.back();
+      llvm::ArrayRef<uint32_t> callees = result.calls.successors(g);
+      if (next < callees.size()) {
+        const uint32_t callee = callees[next++];
+        if (!visited.test(callee)) {
+          visited.set(callee);
+          stack.push_back({callee, 0});
+        }
+        continue;
+      }
+      result.position[g] = result.order.size();
+      result.order.push_back(g);
+      stack.pop_back();
+    }
+  }
+  return result;
+}
+
+StackBoundsAnalysis::Result
+StackBoundsAnalysis::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
+  const CallGroups &call_groups = AM.getResult<CallGroupsAnalysis>(IR);
+  const RecursionBounds &recursion_bounds =
+      AM.getResult<RecursionBoundsAnalysis>(IR);
+  StackBounds bounds;
+  bounds.groups.resize(call_groups.groups.size());
+
+  // The deepest path from each group, callees first.
+  for (uint32_t g : call_groups.order) {
+    const CallGroups::Group &members = call_groups.groups[g];
+    StackBounds::Group &group = bounds.groups[g];
+    group.calls_unknown = members.calls_unknown;
+
+    // The group's own frame: its worst-case depth times its largest frame,
+    // if it's recursive.
+    if (members.recursive) {
+      const std::optional<RecursionBound> *bound =
+          recursion_bounds.lookup(members.members.front());
+      if (bound != nullptr && bound->has_value()) {
+        group.bytes = (*bound)->stack_bytes;
+      } else {
+        group.unbounded = recursion_through(members);
+      }
+    } else if (!members.members.front()->isDeclaration()) {
+      group.bytes = frameBytes(*members.members.front());
+    }
+    for (const llvm::Function *F : members.members) {
+      for (const llvm::Instruction &I : llvm::instructions(*F)) {
+        const auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(&I);
+        if (alloca != nullptr && !alloca->isStaticAlloca() &&
+            group.unbounded.empty()) {
+          group.unbounded = "alloca of a size that isn't fixed in " +
+                            demangled_name(F->getName()).str();
+        }
+      }
+    }
+
+    llvm::ArrayRef<uint32_t> callees = call_groups.calls.successors(g);
+    for (uint32_t callee : callees) {
+      if (call_groups.position[callee] >= call_groups.position[g] &&
+          group.unbounded.empty()) {
+        group.unbounded = "recursion through an indirect call to " +
+                          demangled_name(call_groups.groups[callee]
+                                             .members.front()
+                                             ->getName())
+                              .str();
+        group.deepest = callee;
+      }
+    }
+    uint64_t deepest = 0;
+    for (uint32_t callee : callees) {
+      const StackBounds::Group &below = bounds.groups[callee];
+      if (call_groups.position[callee] >= call_groups.position[g]) {
+        continue;
+      }
+      group.calls_unknown |= below.calls_unknown;
+      if (!group.unbounded.empty()) {
+        continue;
+      }
+      if (!below.unbounded.empty()) {
+        group.unbounded = below.unbounded;
+        group.deepest = callee;
+      } else if (group.deepest == StackBounds::kNoGroup ||
+                 below.bytes > deepest) {
+        deepest = below.bytes;
+        group.deepest = callee;
+      }
+    }
+    group.bytes = group.unbounded.empty()
+                      ? MaxCostLattice::transfer(group.bytes, deepest)
+                      : MaxCostLattice::kUnbounded;
+  }
+  return bounds;
+}
+
+StackBound StackBounds::lookup(const CallGroups &call_groups,
+                               const llvm::Function *F) const {
+  StackBound bound;
+  auto it = call_groups.group_of.find(F);
+  if (it == call_groups.group_of.end()) {
+    bound.calls_unknown = true;
+    return bound;
+  }
+  const Group &group = groups[it->second];
+  bound.bytes = group.bytes;
+  bound.unbounded = group.unbounded;
+  bound.calls_unknown = group.calls_unknown;
+  // An unbounded path ends in a cycle; stop when it comes around.
+  llvm::DenseSet<uint32_t> seen = {it->second};
+  for (uint32_t g = group.deepest; g != kNoGroup && seen.insert(g).second;
+       g = groups[g].deepest) {
+    bound.path.push_back(call_groups.groups[g].members.front());
+  }
+  return bound;
+}
+
+CycleCostsAnalysis::Result
+CycleCostsAnalysis::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
+  const CallGroups &call_groups = AM.getResult<CallGroupsAnalysis>(IR);
+  const RecursionBounds &recursion_bounds =
+      AM.getResult<RecursionBoundsAnalysis>(IR);
+  const IndirectCallTargets &targets =
+      AM.getResult<IndirectCallTargetsAnalysis>(IR);
+  auto &FAM =
+      AM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(IR).getManager();
+  std::optional<std::vector<uint64_t>> table;
+  if (!cycle_table.empty()) {
+    llvm::Expected<std::vector<uint64_t>> read = read_cycle_table(cycle_table);
+    if (read) {
+      table = std::move(*read);
+    } else {
+      IR.getContext().emitError("-bounded-termination-cycle-table: " +
+                                llvm::toString(read.takeError()));
+    }
+  }
+  CycleModel model(std::move(table));
+
+  // Callees first; a callee that isn't done yet is on a cycle.
+  CycleCosts costs;
+  for (uint32_t g : call_groups.order) {
+    const CallGroups::Group &group = call_groups.groups[g];
+    if (!group.recursive) {
+      for (const llvm::Function *F : group.members) {
+        if (!F->isDeclaration()) {
+          costs.functions.insert(
+              {F, functionCycles(const_cast<llvm::Function &>(*F), FAM, model,
+                                 targets, costs)});
+        }
+      }
+      continue;
+    }
+
+    // A recursive group: its worst frame, times its frames.
+    CycleCost cost;
+    if (std::optional<uint64_t> frames =
+            recursionFrames(group, recursion_bounds, FAM)) {
+      for (const llvm::Function *F : group.members) {
+        CycleCost frame = functionCycles(const_cast<llvm::Function &>(*F),
+                                         FAM, model, targets, costs,
+                                         group.members);
+        cost.cycles = MaxCostLattice::join(cost.cycles, frame.cycles);
+        if (cost.unbounded.empty()) {
+          cost.unbounded = std::move(frame.unbounded);
+        }
+        cost.calls_unknown |= frame.calls_unknown;
+      }
+      cost.cycles = llvm::SaturatingMultiply(cost.cycles, *frames);
+    } else {
+      cost.cycles = MaxCostLattice::kUnbounded;
+    }
+    if (cost.cycles == MaxCostLattice::kUnbounded && cost.unbounded.empty()) {
+      cost.unbounded = recursion_through(group);
+    }
+    for (const llvm::Function *F : group.members) {
+      if (!F->isDeclaration()) {
+        costs.functions.insert({F, cost});
+      }
+    }
+  }
+  return costs;
+}
+
+SlowCallsAnalysis::Result
+SlowCallsAnalysis::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
+  const CallGroups &call_groups = AM.getResult<CallGroupsAnalysis>(IR);
+  const RecursionBounds &recursion_bounds =
+      AM.getResult<RecursionBoundsAnalysis>(IR);
+  const IndirectCallTargets &targets =
+      AM.getResult<IndirectCallTargetsAnalysis>(IR);
+  auto &FAM =
+      AM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(IR).getManager();
+  SlowCallCatalog catalog;
+  for (const auto &[kind, name] : kSlowCalls) {
+    catalog.add(kind, name);
+  }
+  if (!slow_calls_file.empty()) {
+    if (llvm::Error error = read_slow_calls(slow_calls_file, catalog)) {
+      IR.getContext().emitError("-bounded-termination-slow-calls: " +
+                                llvm::toString(std::move(error)));
+    }
+  }
+  llvm::DenseMap<const llvm::Function *, SlowCallKind> catalogued;
+  for (const llvm::Function &F : IR) {
+    if (std::optional<SlowCallKind> kind = catalog.lookup(F)) {
+      catalogued.insert({&F, *kind});
+    }
+  }
+
+  // The kinds each group may call, as bits by SlowCallKind. Callees come
+  // first, so one round does it, except around a cycle through an indirect
+  // call.
+  const size_t size = call_groups.groups.size();
+  std::vector<uint8_t> is(size, 0);
+  for (const auto &[F, kind] : catalogued) {
+    is[call_groups.group_of.lookup(F)] |= 1u << size_t(kind);
+  }
+  std::vector<uint8_t> reaches(size, 0);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (uint32_t g : call_groups.order) {
+      uint8_t bits = reaches[g];
+      for (uint32_t callee : call_groups.calls.successors(g)) {
+        bits |= is[callee] | reaches[callee];
+      }
+      changed |= bits != reaches[g];
+      reaches[g] = bits;
+    }
+  }
+
+  // Then how many, callees first, for just the functions that may make
+  // some.
+  SlowCallCounts counts;
+  for (uint32_t g : call_groups.order) {
+    const CallGroups::Group &group = call_groups.groups[g];
+    if (reaches[g] == 0) {
+      continue;
+    }
+    if (!group.recursive) {
+      for (const llvm::Function *F : group.members) {
+        if (F->isDeclaration()) {
+          continue;
+        }
+        SlowCalls calls = functionSlowCalls(
+            const_cast<llvm::Function &>(*F), FAM, reaches[g], catalogued,
+            reaches, call_groups, targets, counts);
+        if (calls.any()) {
+          counts.functions.insert({F, std::move(calls)});
+        }
+      }
+      continue;
+    }
+
+    // A recursive group: its worst frame, times its frames, as for cycles.
+    SlowCalls calls;
+    const std::optional<uint64_t> frames =
+        recursionFrames(group, recursion_bounds, FAM);
+    if (frames) {
+      for (const llvm::Function *F : group.members) {
+        const SlowCalls frame = functionSlowCalls(
+            const_cast<llvm::Function &>(*F), FAM, reaches[g], catalogued,
+            reaches, call_groups, targets, counts, group.members);
+        for (size_t k = 0; k < kSlowCallKinds; ++k) {
+          SlowCalls::Count &count = calls.kinds[k];
+          const SlowCalls::Count &in_frame = frame.kinds[k];
+          count.calls = MaxCostLattice::join(count.calls, in_frame.calls);
+          if (count.unbounded.empty()) {
+            count.unbounded = in_frame.unbounded;
+          }
+          count.example = count.example ? count.example : in_frame.example;
+        }
+      }
+    }
+    for (size_t k = 0; k < kSlowCallKinds; ++k) {
+      SlowCalls::Count &count = calls.kinds[k];
+      if ((reaches[g] & (1u << k)) == 0) {
+        continue;
+      }
+      count.calls = frames ? llvm::SaturatingMultiply(count.calls, *frames)
+                           : MaxCostLattice::kUnbounded;
+      if (count.calls == MaxCostLattice::kUnbounded &&
+          count.unbounded.empty()) {
+        count.unbounded = recursion_through(group);
+      }
+    }
+    if (calls.any()) {
+      for (const llvm::Function *F : group.members) {
+        if (!F->isDeclaration()) {
+          counts.functions.insert({F, calls});
+        }
+      }
+    }
+  }
+  return counts;
+}
+
+// Everything reachable from `roots` by one or more calls,
+// without calling through a function in `stop`.
+llvm::DenseSet<const llvm::Function *>
+reachable_callees(const llvm::CallGraph &CG,
+                  llvm::ArrayRef<const llvm::Function *> roots,
+                  const llvm::DenseSet<const llvm::Function *> &stop) {
+  llvm::DenseSet<const llvm::Function *> reached;
+  llvm::SmallVector<const llvm::Function *, 16> worklist(roots.begin(),
+                                                          roots.end());
+  while (!worklist.empty()) {
+    const llvm::Function *F = worklist.pop_back_val();
+    for (const auto &it : *CG[F]) {
+      const llvm::Function *CalleeF = it.second->getFunction();
+      if (CalleeF == nullptr || !reached.insert(CalleeF).second ||
+          stop.contains(CalleeF)) {
+        continue;
+      }
+      worklist.push_back(CalleeF);
+    }
+  }
+  return reached;
+}
+
+// Verdicts for loops, by header, to use instead of classifying them.
+using LoopOverrides =
+    llvm::DenseMap<const llvm::BasicBlock *, TerminationPassResult>;
+
+// The body of FunctionTerminationPass, and of instantiating its summaries.
+TerminationPassResult analyzeFunction(llvm::Function &F,
+                                      llvm::FunctionAnalysisManager &FAM,
+                                      const LoopOverrides &overrides) {
+  const std::optional<TerminationPassResult> declared = attributeClassifier(F);
+  if (declared && attribute_mode == AttributeMode::Trust) {
+    return *declared;
+  }
+  if (F.empty()) {
+    return FunctionTerminationPass::Result{
+        .elt = DoesThisTerminate::Unknown,
+        .explanation = declared ? "has no basic blocks in this module to "
+                                  "verify that it is " +
+                                      declared->explanation
+                                : "has no basic blocks in this module",
+    };
+  }
+
+  llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+  llvm::LoopInfo &loop_info = FAM.getResult<llvm::LoopAnalysis>(F);
+  const llvm::DominatorTree &DT =
+      FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+
+  // The blocks are numbered, so the solver can work on dense ordinals.
+  const SCCLoopPassResult &cycles = FAM.getResult<SCCLoopPass>(F);
+  const std::vector<const llvm::BasicBlock *> &blocks = cycles.blocks;
+  const auto &ordinals = cycles.ordinals;
+  DenseGraph cfg(blocks.size());
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    for (const llvm::BasicBlock *successor : llvm::successors(blocks[i])) {
+      cfg.add_edge(i, ordinals.lookup(successor));
+    }
+  }
+  cfg.finish();
+
+  // Which blocks can reach a way out (a return, `unreachable`, a `resume`):
+  // one walk back from the blocks with no successors. Whatever can't is
+  // Unbounded however its loops turn out, so it isn't classified at all.
+  llvm::BitVector reaches_exit(blocks.size());
+  llvm::SmallVector<uint32_t, 32> exit_worklist;
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    if (cfg.successors(i).empty()) {
+      reaches_exit.set(i);
+      exit_worklist.push_back(i);
+    }
+  }
+  while (!exit_worklist.empty()) {
+    for (uint32_t predecessor :
+         cfg.predecessors(exit_worklist.pop_back_val())) {
+      if (!reaches_exit.test(predecessor)) {
+        reaches_exit.set(predecessor);
+        exit_worklist.push_back(predecessor);
+      }
+    }
+  }
+
+  std::vector<TerminationPassResult> local_results(blocks.size());
+
+  // Step 1 : do local basic block analysis.
+  // Most instructions complete; calls are handled at the call-graph layer,
+  // except for the ones we can classify here (system calls, inline assembly,
+  // some intrinsics).
+  std::vector<BlockClassification> classifications(blocks.size());
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    classifications[i] = basicBlockClassifier(*blocks[i]);
+  }
+
+  // Step 2 : do loop-level analysis.
+  // We need a ScalarEvolution to get the loops.
+  // Blocks in the same loop share a result, so only classify each loop once.
+  llvm::DenseMap<const llvm::Loop *, TerminationPassResult> loop_results;
+  std::vector<ContendedLoop> contended_loops;
+  llvm::SmallPtrSet<const llvm::BasicBlock *, 4> contended_headers;
+  std::vector<ArgumentBoundedLoop> argument_bounded_loops;
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    TerminationPassResult &block_result = classifications[i].result;
+    llvm::Loop *loop = loop_info.getLoopFor(blocks[i]);
+    if (!reaches_exit.test(i)) {
+      if (block_result.elt == DoesThisTerminate::Unbounded) {
+        local_results[i] = block_result;
+      } else if (cycles.in_cycle.test(i)) {
+        local_results[i] = TerminationPassResult{
+            .elt = DoesThisTerminate::Unbounded,
+            .explanation = loop != nullptr
+                               ? "includes loop that never reaches an exit"
+                               : "includes a cycle that never reaches an exit",
+        };
+      } else {
+        // On the way to such a loop; let the explanation go on to it.
+        local_results[i] = TerminationPassResult{
+            .elt = DoesThisTerminate::Unbounded,
+            .explanation = "",
+        };
+      }
+      continue;
+    }
+    if (loop == nullptr && cycles.in_cycle.test(i)) {
+      // A cycle with more than one entry has no header, so LoopInfo (and
+      // SCEV) can't see it; we can't bound it either.
+      const DoesThisTerminate elt = TerminationLattice::transfer(
+          block_result.elt, DoesThisTerminate::Unknown);
+      if (elt == block_result.elt && !block_result.explanation.empty()) {
+        local_results[i] = block_result;
+      } else {
+        local_results[i] = TerminationPassResult{
+            .elt = elt,
+            .explanation = "includes a cycle that isn't a natural loop",
+        };
+      }
+      continue;
+    }
+    if (loop == nullptr) {
+      // Block is as bounded as its instructions.
+      local_results[i] = block_result;
+      continue;
+    }
+    // If the loop is bounded, we count this node as bounded too.
+    auto it = loop_results.find(loop);
+    if (it == loop_results.end()) {
+      TerminationPassResult loop_result;
+      if (auto override = overrides.find(loop->getHeader());
+          override != overrides.end()) {
+        loop_result = override->second;
+      } else {
+        loop_result = loopClassifier(*loop, SE);
+      }
+      if (loop_result.elt == DoesThisTerminate::Unknown) {
+        if (auto contended = contentionClassifier(*loop)) {
+          loop_result.explanation =
+              contended->kind == ContendedLoop::Kind::CompareExchangeRetry
+                  ? "includes loop that retries a compare-and-swap until it "
+                    "succeeds"
+                  : "includes loop that spins until another thread writes";
+          contended_loops.push_back(std::move(*contended));
+          contended_headers.insert(loop->getHeader());
+        } else if (auto summary = argumentBoundClassifier(*loop, SE, DT)) {
+          loop_result.explanation =
+              "includes loop whose bound depends on its arguments";
+          argument_bounded_loops.push_back(std::move(*summary));
+        }
+      }
+      it = loop_results.insert({loop, std::move(loop_result)}).first;
+    }
+    const TerminationPassResult &loop_result = it->second;
+    // The block's instructions, then (maybe) around the loop again.
+    const DoesThisTerminate elt =
+        TerminationLattice::transfer(block_result.elt, loop_result.elt);
+    if (elt == block_result.elt && !block_result.explanation.empty()) {
+      local_results[i] = block_result;
+    } else if (loop_result.elt == DoesThisTerminate::Unknown &&
+               classifications[i].has_volatile &&
+               !contended_headers.contains(loop->getHeader())) {
+      local_results[i] = TerminationPassResult{
+          .elt = elt,
+          .explanation =
+              loop_result.explanation + ", waiting on volatile memory",
+      };
+    } else {
+      local_results[i] = TerminationPassResult{
+          .elt = elt,
+          .explanation = loop_result.explanation,
+      };
+    }
+  }
+  // With a profile, note how hot the loops that matter are. The counts are
+  // the front end's !prof metadata; see build/default.ll.do.
+  std::optional<uint64_t> entry_count;
+  std::vector<LoopProfile> loop_profiles;
+  if (auto count = F.getEntryCount()) {
+    entry_count = count->getCount();
+    llvm::BlockFrequencyInfo &BFI =
+        FAM.getResult<llvm::BlockFrequencyAnalysis>(F);
+    for (const auto &[loop, loop_result] : loop_results) {
+      const auto header_count = BFI.getBlockProfileCount(loop->getHeader());
+      const auto trip_count =
+          llvm::getLoopEstimatedTripCount(const_cast<llvm::Loop *>(loop));
+      std::optional<unsigned> trips;
+      if (trip_count) {
+        trips = *trip_count;
+      }
+      if (loop_result.elt != DoesThisTerminate::Bounded ||
+          (trips && *trips > trip_threshold)) {
+        loop_profiles.push_back(LoopProfile{
+            .header = loop->getHeader(),
+            .elt = loop_result.elt,
+            .header_count = header_count ? *header_count : 0,
+            .trip_count = trips,
+        });
+      }
+    }
+    llvm::sort(loop_profiles, [](const LoopProfile &a, const LoopProfile &b) {
+      return a.header_count > b.header_count;
+    });
+  }
+  // All blocks are labeled:
+  // - Bounded if not part of a loop, and nothing in it blocks.
+  // - Unbounded if something in it blocks (a system call).
+  // - Unknown if a loop bound cannot be determined, or there's something in
+  //   it we can't see into (inline assembly).
+
+  // Step 3 : aggregate results.
+  // In order to accurately capture:
+  /*
+  * void maybe_hold(bool stall) {
+  *   if(stall) {
+  *     while(true) {}
+  *   } else {
+  *     return;
+  *   }
+  */
+  // We need to propagate towards the entry block,
+  // then use the entry block to determine the function's result.
+  // Each block's result is `transfer(local, join(successors))`: "run this
+  // block, then whichever successor". Starting from Unevaluated, a block only
+  // picks up "may terminate" if some path from it reaches an exit - so a loop
+  // with no exit comes out Unbounded, not Unknown; those blocks are already
+  // labeled Unbounded above, and settle on the first visit. Consider:
+  // void does_not_terminate(bool stall) {
+  //   if(stall) { // entry block: B1, successors are B2/B3
+  //     while(true) {} // B2: predecessors are is B1, B2, successor is B2
+  //   } else {
+  //     while(true) {} // B3: predecessors are B1, B3, successor is B3
+  //  }
+  //  // B4? Exit block? May not exist, has no predecessors
+  // }
+  // `transfer` is monotone (checked in TerminationLattice.h), so the worklist
+  // quiesces.
+  std::vector<DoesThisTerminate> local_elts(blocks.size());
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    local_elts[i] = local_results[i].elt;
+  }
+  const std::vector<DoesThisTerminate> elts =
+      solve_backward<TerminationLattice>(cfg, local_elts);
+
+  // The worklist only tracks verdicts; explain the entry block's.
+  TerminationPassResult result = explainFrom(cfg, elts, local_results);
+
+  // Step 4 : exception handling.
+  // EH pads (landing pads, catch and cleanup pads) only run once something
+  // throws. The normal path is the CFG without the edges into them, where a
+  // throw isn't a way out; the unwind path is everything from the pads on.
+  std::vector<uint32_t> pads;
+  bool throws = false;
+  for (uint32_t i = 0; i < blocks.size(); ++i) {
+    if (blocks[i]->isEHPad()) {
+      pads.push_back(i);
+    }
+    throws |= classifications[i].throws;
+  }
+  if (!pads.empty() || throws) {
+    DenseGraph normal(blocks.size());
+    std::vector<DoesThisTerminate> normal_elts(local_elts);
+    std::vector<TerminationPassResult> normal_results(local_results);
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+      if (classifications[i].throws &&
+          classifications[i].before_throw != DoesThisTerminate::Unbounded) {
+        normal_elts[i] = DoesThisTerminate::Unevaluated;
+        normal_results[i] = TerminationPassResult{
+            .elt = DoesThisTerminate::Unevaluated,
+            .explanation = "throws an exception",
+        };
+        continue;
+      }
+      for (const llvm::BasicBlock *successor : llvm::successors(blocks[i])) {
+        if (!successor->isEHPad()) {
+          normal.add_edge(i, ordinals.lookup(successor));
+        }
+      }
+    }
+    normal.finish();
+    normal_elts = solve_backward<TerminationLattice>(normal, normal_elts);
+    TerminationPassResult normal_result =
+        explainFrom(normal, normal_elts, normal_results);
+    if (normal_result.elt == DoesThisTerminate::Unevaluated) {
+      // Every path throws.
+      normal_result.elt = DoesThisTerminate::Unbounded;
+      normal_result.explanation = "never returns normally: " +
+                                  normal_result.explanation;
+    }
+    result.normal_path = PathResult{
+        .elt = normal_result.elt,
+        .explanation = std::move(normal_result.explanation),
+    };
+
+    if (!pads.empty()) {
+      std::vector<DoesThisTerminate> after;
+      DoesThisTerminate unwind = DoesThisTerminate::Unevaluated;
+      for (uint32_t pad : pads) {
+        after.push_back(elts[pad]);
+        unwind = TerminationLattice::join(unwind, elts[pad]);
+      }
+      bool joined = false;
+      const size_t witness = pick_witness(unwind, after, &joined);
+      TerminationPassResult unwind_result =
+          explainFrom(cfg, elts, local_results, pads[witness]);
+      result.unwind_path = PathResult{
+          .elt = unwind,
+          .explanation = (joined ? "Joined with Unbounded branch: " : "") +
+                         unwind_result.explanation,
+      };
+    }
+    if (unwind_mode == UnwindMode::Separate) {
+      result.elt = result.normal_path->elt;
+      result.explanation = result.normal_path->explanation;
+    }
+  }
+
+  result.contended_loops = std::move(contended_loops);
+  result.argument_bounded_loops = std::move(argument_bounded_loops);
+  result.entry_count = entry_count;
+  result.loop_profiles = std::move(loop_profiles);
+  result.block_elts = elts;
+  if (declared && declared->elt != result.elt) {
+    result.explanation += " (but " + declared->explanation + ")";
+  }
+  return result;
+}
+
+FunctionTerminationPass::Result
+FunctionTerminationPass::run(llvm::Function &F,
+                             llvm::FunctionAnalysisManager &FAM) {
+  if (carried != nullptr) {
+    if (auto it = carried->find(&F); it != carried->end()) {
+      return it->second;
+    }
+  }
+  return analyzeFunction(F, FAM, LoopOverrides());
+}
+
+// The arguments a summary depends on, in order.
+llvm::SmallVector<unsigned, 4>
+summaryArguments(const TerminationPassResult &summary) {
+  llvm::SmallVector<unsigned, 4> arguments;
+  for (const ArgumentBoundedLoop &loop : summary.argument_bounded_loops) {
+    arguments.append(loop.arguments.begin(), loop.arguments.end());
+  }
+  llvm::sort(arguments);
+  arguments.erase(std::unique(arguments.begin(), arguments.end()),
+                  arguments.end());
+  return arguments;
+}
+
+// Re-analyzes `F` with constant `values` for the arguments its summary
+// depends on (see summaryArguments).
+TerminationPassResult
+instantiateSummary(llvm::Function &F, llvm::FunctionAnalysisManager &FAM,
+                   const TerminationPassResult &summary,
+                   llvm::ArrayRef<int64_t> values) {
+  llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+  llvm::LoopInfo &loop_info = FAM.getResult<llvm::LoopAnalysis>(F);
+
+  llvm::ValueToSCEVMapTy constants;
+  const llvm::SmallVector<unsigned, 4> arguments = summaryArguments(summary);
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    llvm::Argument *argument = F.getArg(arguments[i]);
+    constants.insert({argument, SE.getConstant(argument->getType(), values[i],
+                                               /*isSigned=*/true)});
+  }
+  auto fold = [&](const llvm::SCEV *S) {
+    return llvm::dyn_cast<llvm::SCEVConstant>(
+        llvm::SCEVParameterRewriter::rewrite(S, SE, constants));
+  };
+
+  LoopOverrides overrides;
+  for (const ArgumentBoundedLoop &summary_loop :
+       summary.argument_bounded_loops) {
+    const llvm::Loop *loop = loop_info.getLoopFor(summary_loop.header);
+    const std::optional<LoopExitTest> test =
+        exitTest(*loop, *summary_loop.exiting, SE);
+    if (!test) {
+      continue;
+    }
+    const llvm::SCEVConstant *start = fold(test->iv->getStart());
+    const llvm::SCEVConstant *step = fold(test->iv->getStepRecurrence(SE));
+    const llvm::SCEVConstant *limit = fold(test->limit);
+    if (start == nullptr || step == nullptr || limit == nullptr) {
+      continue;
+    }
+    if (eventuallyExits(test->stay, start->getAPInt(), step->getAPInt(),
+                        limit->getAPInt())) {
+      overrides.insert(
+          {summary_loop.header,
+           TerminationPassResult{
+               .elt = DoesThisTerminate::Bounded,
+               .explanation =
+                   "includes a loop, but it has a fixed bound for these "
+                   "arguments",
+           }});
+    } else if (loop->getExitingBlock() == summary_loop.exiting) {
+      overrides.insert(
+          {summary_loop.header,
+           TerminationPassResult{
+               .elt = DoesThisTerminate::Unbounded,
+               .explanation = "includes loop that never exits for these "
+                              "arguments",
+           }});
+    }
+  }
+  return analyzeFunction(F, FAM, overrides);
+}
+
+ModuleTerminationPass::Result
+ModuleTerminationPass::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
+  std::map<const llvm::Function *, TerminationPassResult> per_function_results;
 
   auto &function_analysis_manager_proxy =
       AM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(IR);
   auto &FAM = function_analysis_manager_proxy.getManager();
+  const TerminationAnnotations &annotations =
+      AM.getResult<TerminationAnnotationsAnalysis>(IR);
+  llvm::CallGraph &CG = AM.getResult<llvm::CallGraphAnalysis>(IR);
+  const IndirectCallTargets &targets =
+      AM.getResult<IndirectCallTargetsAnalysis>(IR);
+
+  // Step 0 : prune.
+  // Functions annotated assume-* aren't analyzed; neither is anything that
+  // only they call. The same goes for trusted attributes, and pinned results.
+  llvm::DenseSet<const llvm::Function *> assumed;
+  for (const auto *set :
+       {&annotations.assume_bounded, &annotations.assume_unbounded}) {
+    assumed.insert(set->begin(), set->end());
+  }
+  const Pinned no_pins;
+  const Pinned &pins = pinned != nullptr ? *pinned : no_pins;
+  for (const auto &[F, _] : pins) {
+    assumed.insert(F);
+  }
+  if (attribute_mode == AttributeMode::Trust) {
+    for (const llvm::Function &F : IR) {
+      if (attributeClassifier(F)) {
+        assumed.insert(&F);
+      }
+    }
+  }
+  llvm::DenseSet<const llvm::Function *> analyzed;
+  if (!assumed.empty()) {
+    std::vector<const llvm::Function *> assumed_list(assumed.begin(),
+                                                     assumed.end());
+    const auto under_assumed = reachable_callees(CG, assumed_list, {});
+    std::vector<const llvm::Function *> roots;
+    for (const llvm::Function &F : IR) {
+      if (!assumed.contains(&F) && !under_assumed.contains(&F)) {
+        roots.push_back(&F);
+      }
+    }
+    analyzed = reachable_callees(CG, roots, assumed);
+    analyzed.insert(roots.begin(), roots.end());
+  }
+
   // Step 1 : function-local analysis
+  size_t skipped = 0;
   for (llvm::Function &function : IR) {
-    per_function_results.insert(
-        {&function, FAM.getResult<FunctionTerminationPass>(function)});
+    if (auto it = pins.find(&function); it != pins.end()) {
+      per_function_results.insert({&function, it->second});
+    } else if (annotations.assume_bounded.contains(&function)) {
+      per_function_results.insert(
+          {&function, TerminationPassResult{
+                          .elt = DoesThisTerminate::Bounded,
+                          .explanation = "assumed Bounded by annotation",
+                      }});
+    } else if (annotations.assume_unbounded.contains(&function)) {
+      per_function_results.insert(
+          {&function, TerminationPassResult{
+                          .elt = DoesThisTerminate::Unbounded,
+                          .explanation = "assumed Unbounded by annotation",
+                      }});
+    } else if (assumed.empty() || assumed.contains(&function) ||
+               analyzed.contains(&function)) {
+      per_function_results.insert(
+          {&function, FAM.getResult<FunctionTerminationPass>(function)});
+    } else {
+      ++skipped;
+    }
   }
 
   // Step 2 : CGSCC analysis.
-  // Take anything in a recursive group and force it Unknown.
-  // See also NoRecursionCheck in clang-tidy
-  llvm::CallGraph &CG = AM.getResult<llvm::CallGraphAnalysis>(IR);
+  // Take anything in a recursive group we can't bound the depth of, and force
+  // it Unknown. See also NoRecursionCheck in clang-tidy
+  const RecursionBounds &recursion_bounds =
+      AM.getResult<RecursionBoundsAnalysis>(IR);
   for (llvm::scc_iterator<llvm::CallGraph *> SCCI = llvm::scc_begin(&CG);
        !SCCI.isAtEnd(); ++SCCI) {
     if (!SCCI.hasCycle()) {
       // SCC doesn't have a loop. We don't need to update anything.
       continue;
     }
+    // If the recursion is bounded, the group's calls to itself are just
+    // calls; propagation handles them like any other.
+    const llvm::Function *first = SCCI->front()->getFunction();
+    const std::optional<RecursionBound> *bound =
+        recursion_bounds.lookup(first);
+    if (bound != nullptr && bound->has_value()) {
+      for (llvm::CallGraphNode *node : *SCCI) {
+        auto it = per_function_results.find(node->getFunction());
+        if (it != per_function_results.end() &&
+            !assumed.contains(it->first)) {
+          it->second.recursion = **bound;
+        }
+      }
+      continue;
+    }
     // SCC has a loop. Update all functions to note they're mutually recursive.
     const std::vector<llvm::CallGraphNode *> &nextSCC = *SCCI;
     TerminationPassResult shared_result = {
@@ -432,8 +3844,7 @@ ModuleTerminationPass::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
       if (f == nullptr) {
         continue;
       }
-      shared_result.explanation =
-          (shared_result.explanation + llvm::demangle(f->getName()));
+      shared_result.explanation += demangled_name(f->getName());
       if (count < nextSCC.size() - 1) {
         shared_result.explanation += ", ";
       } else {
@@ -442,63 +3853,778 @@ ModuleTerminationPass::run(llvm::Module &IR, llvm::ModuleAnalysisManager &AM) {
     }
     for (llvm::CallGraphNode *node : nextSCC) {
       llvm::Function *f = node->getFunction();
-      const auto new_result = update(per_function_results[f], {shared_result});
-      per_function_results[f] = new_result;
-    }
-  }
-  // Step 3 : worklist algorithm on the call graph.
-  // Ideally we'd _just_ do worklist, but we don't have a "callers" list, alas.
-  // So we just run N^2: scan through each function, update from callees,
-  // and run again if we updated something.
-  bool stale = true;
-  while (stale) {
-    stale = false;
-    for (auto &F : IR) {
-      TerminationPassResult original = per_function_results[&F];
-      const llvm::CallGraphNode *CGNode = CG[&F];
-      std::vector<TerminationPassResult> results;
-
-      // Update this node from its successors.
-      for (const auto &it : *CGNode) {
-        llvm::CallGraphNode *callee = it.second;
-        if (auto *CalleeF = callee->getFunction(); CalleeF != nullptr) {
-          const auto &result = per_function_results[CalleeF];
-          results.emplace_back(TerminationPassResult{
-              .elt = result.elt,
-              .explanation = "via call to " +
-                             llvm::demangle(CalleeF->getName()) + ": " +
-                             result.explanation,
-          });
+      auto it = per_function_results.find(f);
+      if (it == per_function_results.end() || assumed.contains(f)) {
+        continue;
+      }
+      TerminationPassResult &result = it->second;
+      if (result.elt != DoesThisTerminate::Unknown) {
+        result.elt = shared_result.elt;
+        result.explanation = shared_result.explanation;
+      }
+      // Constant arguments don't help with the recursion.
+      result.argument_bounded_loops.clear();
+    }
+  }
+  // Step 3 : propagate along the call graph.
+  // Number the functions callees-first, so propagation settles quickly,
+  // and flatten the call graph into CSR form.
+  std::vector<const llvm::Function *> functions;
+  llvm::DenseMap<const llvm::Function *, uint32_t> ordinals;
+  for (llvm::scc_iterator<llvm::CallGraph *> SCCI = llvm::scc_begin(&CG);
+       !SCCI.isAtEnd(); ++SCCI) {
+    for (llvm::CallGraphNode *node : *SCCI) {
+      const llvm::Function *f = node->getFunction();
+      if (f != nullptr && per_function_results.count(f)) {
+        ordinals.insert({f, functions.size()});
+        functions.push_back(f);
+      }
+    }
+  }
+  // Functions that aren't reachable from outside the module don't show up
+  // in the SCC walk; add them at the end.
+  for (const auto &[F, _] : per_function_results) {
+    if (ordinals.insert({F, functions.size()}).second) {
+      functions.push_back(F);
+    }
+  }
+
+  // Each set of indirect-call targets gets a node after the functions,
+  // which calls every candidate.
+  const uint32_t first_dispatch = functions.size();
+  // Each distinct call (function, constant arguments) to a function with a
+  // summary gets a node after those, with the function's callees.
+  const uint32_t first_context = first_dispatch + targets.sets.size();
+  using Context = std::pair<const llvm::Function *, std::vector<int64_t>>;
+  std::map<Context, uint32_t> context_ordinals;
+  std::vector<Context> contexts;
+  auto context_of = [&](const llvm::CallBase *call,
+                        const llvm::Function *CalleeF) -> std::optional<Context> {
+    auto summary = per_function_results.find(CalleeF);
+    if (call == nullptr || summary == per_function_results.end() ||
+        summary->second.argument_bounded_loops.empty()) {
+      return std::nullopt;
+    }
+    Context context = {CalleeF, {}};
+    for (unsigned argument : summaryArguments(summary->second)) {
+      const auto *value =
+          llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(argument));
+      if (value == nullptr || value->getBitWidth() > 64) {
+        return std::nullopt;
+      }
+      context.second.push_back(value->getSExtValue());
+    }
+    return context;
+  };
+
+  CSRCallGraph csr;
+  std::vector<DoesThisTerminate> locals;
+  for (uint32_t i = 0; i < functions.size(); ++i) {
+    // An assumed verdict doesn't depend on the callees.
+    const bool is_assumed = assumed.contains(functions[i]);
+    for (const auto &it : *CG[functions[i]]) {
+      if (is_assumed || is_resolved_locally(it)) {
+        continue;
+      }
+      if (auto *CalleeF = it.second->getFunction(); CalleeF != nullptr) {
+        if (auto context = context_of(call_of(it), CalleeF)) {
+          auto [ordinal, inserted] = context_ordinals.insert(
+              {*context, first_context + contexts.size()});
+          if (inserted) {
+            contexts.push_back(std::move(*context));
+          }
+          csr.add_edge(ordinal->second);
         } else {
-          // Callee is nullptr. Does that mean it's indirect?
-          // TODO: Not sure; we need more testing of indirect calls.
-          results.emplace_back(TerminationPassResult{
-              .elt = DoesThisTerminate::Unknown,
-              .explanation = "via call to unknown function",
-          });
+          csr.add_edge(ordinals.lookup(CalleeF));
         }
+        continue;
+      }
+      // Callee is nullptr: an indirect call, or a call out of the module.
+      const llvm::CallBase *call = call_of(it);
+      std::optional<uint32_t> set;
+      if (call != nullptr && call->isIndirectCall()) {
+        set = targets.lookup(*call);
+      }
+      if (set) {
+        csr.add_edge(first_dispatch + *set);
+      } else {
+        csr.add_unknown_edge();
+      }
+    }
+    csr.finish_node();
+    locals.push_back(per_function_results[functions[i]].elt);
+  }
+  for (uint32_t set = 0; set < targets.sets.size(); ++set) {
+    for (const llvm::Function *candidate : targets.sets[set]) {
+      // Candidates we skipped might do anything.
+      if (auto it = ordinals.find(candidate); it != ordinals.end()) {
+        csr.add_edge(it->second);
+      } else {
+        csr.add_unknown_edge();
+      }
+    }
+    csr.finish_node();
+    // Dispatching is as bounded as what it dispatches to.
+    locals.push_back(DoesThisTerminate::Bounded);
+  }
+  // Instantiate each context once, however many calls share it.
+  std::vector<TerminationPassResult> context_results;
+  for (const auto &[F, values] : contexts) {
+    const uint32_t f = ordinals.lookup(F);
+    for (uint32_t e = csr.offsets[f]; e < csr.offsets[f + 1]; ++e) {
+      csr.add_edge(csr.callees[e]);
+    }
+    if (f / 64 < csr.calls_unknown.size() &&
+        ((csr.calls_unknown[f / 64] >> (f % 64)) & 1)) {
+      csr.add_unknown_edge();
+    }
+    csr.finish_node();
+    context_results.push_back(
+        instantiateSummary(const_cast<llvm::Function &>(*F), FAM,
+                           per_function_results[F], values));
+    locals.push_back(context_results.back().elt);
+  }
+  // Recursion through an indirect call. CallGraph sends indirect calls to
+  // its external node, so Step 2 (and RecursionBounds) never saw these
+  // cycles; here they go through a dispatch node. Force them Unknown, as in
+  // Step 2: propagation starts from the local verdicts, so a cycle would
+  // otherwise keep whatever its members say on their own.
+  const CSRComponents components = strongly_connected(csr);
+  std::vector<std::vector<uint32_t>> indirect_cycles(components.cyclic.size());
+  for (uint32_t set = 0; set < targets.sets.size(); ++set) {
+    const uint32_t component = components.component[first_dispatch + set];
+    if (components.cyclic[component] && indirect_cycles[component].empty()) {
+      indirect_cycles[component].push_back(first_dispatch + set);
+    }
+  }
+  for (uint32_t n = 0; n < csr.size(); ++n) {
+    std::vector<uint32_t> &members = indirect_cycles[components.component[n]];
+    if (!members.empty() && (n < first_dispatch || n >= first_context)) {
+      members.push_back(n);
+    }
+  }
+  for (llvm::ArrayRef<uint32_t> members : indirect_cycles) {
+    if (members.empty()) {
+      continue;
+    }
+    // The first member is a dispatch node.
+    members = members.drop_front();
+    std::string explanation =
+        "part of a call graph that contains a loop through an indirect "
+        "call: ";
+    for (size_t i = 0; i < members.size(); ++i) {
+      const uint32_t n = members[i];
+      const llvm::Function *F = n < first_dispatch
+                                    ? functions[n]
+                                    : contexts[n - first_context].first;
+      explanation += (i ? ", " : "") + demangled_name(F->getName()).str();
+    }
+    for (uint32_t n : members) {
+      TerminationPassResult &result =
+          n < first_dispatch ? per_function_results[functions[n]]
+                             : context_results[n - first_context];
+      if (result.elt != DoesThisTerminate::Unknown) {
+        result.elt = DoesThisTerminate::Unknown;
+        result.explanation = explanation;
+      }
+      locals[n] = DoesThisTerminate::Unknown;
+    }
+  }
+  LatticePlanes planes(csr.size());
+  for (uint32_t n = 0; n < csr.size(); ++n) {
+    planes.set(n, static_cast<unsigned>(locals[n]));
+  }
+  propagate_planes(csr, planes);
+
+  // Step 4 : explanations.
+  // The planes only carry the verdict. For each function whose verdict moved,
+  // find the callee responsible...
+  constexpr uint32_t kUnknownCallee = ~0u;
+  struct Witness {
+    uint32_t callee;
+    bool joined;
+    bool indirect = false;
+  };
+  std::vector<DoesThisTerminate> after;
+  std::vector<uint32_t> callees;
+  auto find_witness = [&](uint32_t n) -> std::optional<Witness> {
+    after.clear();
+    callees.clear();
+    for (uint32_t e = csr.offsets[n]; e < csr.offsets[n + 1]; ++e) {
+      const uint32_t callee = csr.callees[e];
+      callees.push_back(callee);
+      after.push_back(static_cast<DoesThisTerminate>(planes.get(callee)));
+    }
+    if (n / 64 < csr.calls_unknown.size() &&
+        ((csr.calls_unknown[n / 64] >> (n % 64)) & 1)) {
+      callees.push_back(kUnknownCallee);
+      after.push_back(DoesThisTerminate::Unknown);
+    }
+    bool joined = false;
+    const size_t witness =
+        pick_witness(static_cast<DoesThisTerminate>(planes.get(n)), after,
+                     &joined);
+    if (witness == after.size()) {
+      return std::nullopt;
+    }
+    return Witness{callees[witness], joined};
+  };
+  // Results and names for function and context nodes.
+  auto result_of = [&](uint32_t n) -> TerminationPassResult & {
+    if (n < first_dispatch) {
+      return per_function_results[functions[n]];
+    }
+    return context_results[n - first_context];
+  };
+  auto name_of = [&](uint32_t n) {
+    if (n < first_dispatch) {
+      return demangled_name(functions[n]->getName()).str();
+    }
+    const auto &[F, values] = contexts[n - first_context];
+    std::string name = demangled_name(F->getName()).str() + "(";
+    for (size_t i = 0; i < values.size(); ++i) {
+      name += (i ? ", " : "") + std::to_string(values[i]);
+    }
+    return name + ")";
+  };
+  auto is_dispatch = [&](uint32_t n) {
+    return n >= first_dispatch && n < first_context;
+  };
+  llvm::DenseMap<uint32_t, Witness> witnesses;
+  for (uint32_t i = 0; i < csr.size(); ++i) {
+    if (is_dispatch(i)) {
+      continue;
+    }
+    const auto elt = static_cast<DoesThisTerminate>(planes.get(i));
+    if (elt == locals[i]) {
+      continue;
+    }
+    std::optional<Witness> witness = find_witness(i);
+    // Blame a candidate of an indirect call, not the dispatch node.
+    if (witness && witness->callee != kUnknownCallee &&
+        is_dispatch(witness->callee)) {
+      const bool joined = witness->joined;
+      witness = find_witness(witness->callee);
+      if (witness) {
+        witness->joined |= joined;
+        witness->indirect = true;
+      }
+    }
+    if (witness) {
+      witnesses.insert({i, *witness});
+    }
+  }
+  // ...then write out the chains, innermost callee first.
+  llvm::BitVector done(csr.size());
+  std::vector<uint32_t> chain;
+  for (uint32_t start = 0; start < csr.size(); ++start) {
+    if (is_dispatch(start)) {
+      continue;
+    }
+    for (uint32_t n = start; !done.test(n);) {
+      done.set(n);
+      chain.push_back(n);
+      auto it = witnesses.find(n);
+      if (it == witnesses.end() || it->second.callee == kUnknownCallee) {
+        break;
+      }
+      n = it->second.callee;
+    }
+    while (!chain.empty()) {
+      const uint32_t n = chain.back();
+      chain.pop_back();
+      TerminationPassResult &result = result_of(n);
+      result.elt = static_cast<DoesThisTerminate>(planes.get(n));
+      auto it = witnesses.find(n);
+      if (it == witnesses.end()) {
+        continue;
+      }
+      const Witness &witness = it->second;
+      std::string explanation =
+          witness.joined ? "Joined with Unbounded branch: " : "";
+      explanation +=
+          witness.indirect ? "via indirect call to " : "via call to ";
+      if (witness.callee == kUnknownCallee) {
+        explanation += "unknown function";
+      } else {
+        explanation += name_of(witness.callee) + ": " +
+                       result_of(witness.callee).explanation;
+      }
+      result.explanation = std::move(explanation);
+    }
+  }
+  // Anything else that moved did so without a single callee to blame.
+  for (uint32_t i = 0; i < functions.size(); ++i) {
+    per_function_results[functions[i]].elt =
+        static_cast<DoesThisTerminate>(planes.get(i));
+  }
+
+  // Step 5 : root causes.
+  // Following the witnesses from a function ends at what it's charged to:
+  // the function or instantiation its explanation bottoms out in. Each
+  // function is charged to exactly one cause, so this is one walk over the
+  // witness forest, linear in the call graph; counting every function that
+  // can reach each cause instead would be quadratic.
+  constexpr uint32_t kNoCause = ~0u;
+  std::vector<uint32_t> cause(csr.size(), kNoCause);
+  for (uint32_t start = 0; start < csr.size(); ++start) {
+    if (is_dispatch(start) || cause[start] != kNoCause) {
+      continue;
+    }
+    chain.clear();
+    uint32_t n = start;
+    while (cause[n] == kNoCause) {
+      // Provisionally its own cause, which also ends a cycle of witnesses.
+      cause[n] = n;
+      chain.push_back(n);
+      auto it = witnesses.find(n);
+      if (it == witnesses.end() || it->second.callee == kUnknownCallee) {
+        break;
       }
-      auto altered = update(original, std::move(results));
-      if (altered.elt != original.elt) {
-        per_function_results[&F] = altered;
-        stale = true;
+      n = it->second.callee;
+    }
+    for (uint32_t m : chain) {
+      cause[m] = cause[n];
+    }
+  }
+  std::vector<size_t> poisoned(csr.size()), must_be_bounded(csr.size());
+  for (uint32_t i = 0; i < functions.size(); ++i) {
+    const auto elt = static_cast<DoesThisTerminate>(planes.get(i));
+    if (elt == DoesThisTerminate::Bounded ||
+        elt == DoesThisTerminate::Unevaluated) {
+      continue;
+    }
+    poisoned[cause[i]] += cause[i] != i;
+    must_be_bounded[cause[i]] += annotations.must_be_bounded.contains(
+        functions[i]);
+  }
+  std::vector<RootCause> root_causes;
+  for (uint32_t n = 0; n < csr.size(); ++n) {
+    const auto elt = static_cast<DoesThisTerminate>(planes.get(n));
+    if (is_dispatch(n) || cause[n] != n ||
+        elt == DoesThisTerminate::Bounded ||
+        elt == DoesThisTerminate::Unevaluated ||
+        (n >= first_dispatch && poisoned[n] == 0)) {
+      continue;
+    }
+    root_causes.push_back(RootCause{
+        .name = name_of(n),
+        .elt = elt,
+        .explanation = result_of(n).explanation,
+        .poisoned = poisoned[n],
+        .must_be_bounded = must_be_bounded[n],
+    });
+  }
+  llvm::stable_sort(root_causes, [](const RootCause &a, const RootCause &b) {
+    return std::make_pair(a.poisoned, a.must_be_bounded) >
+           std::make_pair(b.poisoned, b.must_be_bounded);
+  });
+
+  // Step 6 : stack.
+  // Where a stack runs out matters where it starts, and in critical sections.
+  const CallGroups &call_groups = AM.getResult<CallGroupsAnalysis>(IR);
+  const StackBounds &stack_bounds = AM.getResult<StackBoundsAnalysis>(IR);
+  const llvm::DenseSet<const llvm::Function *> roots(
+      call_groups.roots.begin(), call_groups.roots.end());
+  std::vector<const llvm::Function *> limited;
+  for (auto &[F, result] : per_function_results) {
+    if (annotations.must_be_bounded.contains(F) || roots.contains(F)) {
+      result.stack = stack_bounds.lookup(call_groups, F);
+      limited.push_back(F);
+    }
+  }
+
+  // Step 7 : cycles.
+  if (cycles_enabled()) {
+    const CycleCosts &cycle_costs = AM.getResult<CycleCostsAnalysis>(IR);
+    for (auto &[F, result] : per_function_results) {
+      if (auto it = cycle_costs.functions.find(F);
+          it != cycle_costs.functions.end()) {
+        result.cycles = it->second;
       }
     }
   }
 
-  return ModuleTerminationPassResult{per_function_results};
+  // Step 8 : slow calls.
+  // Where they're made from, and in critical sections; they're not part of
+  // the verdict.
+  const SlowCallCounts &slow_calls = AM.getResult<SlowCallsAnalysis>(IR);
+  std::vector<const llvm::Function *> banned_calls;
+  for (auto &[F, result] : per_function_results) {
+    auto it = slow_calls.functions.find(F);
+    if (it == slow_calls.functions.end() ||
+        !(annotations.must_be_bounded.contains(F) || roots.contains(F))) {
+      continue;
+    }
+    result.slow_calls = it->second;
+    const bool banned = llvm::any_of(banned_kinds, [&](SlowCallKind kind) {
+      return it->second.kinds[size_t(kind)].calls != 0;
+    });
+    if (banned && annotations.must_be_bounded.contains(F)) {
+      banned_calls.push_back(F);
+    }
+  }
+
+  std::vector<const llvm::Function *> violations;
+  for (const llvm::Function *F : functions) {
+    if (annotations.must_be_bounded.contains(F) &&
+        per_function_results[F].elt != DoesThisTerminate::Bounded) {
+      violations.push_back(F);
+    }
+  }
+
+  return ModuleTerminationPassResult{
+      .per_function_results = std::move(per_function_results),
+      .must_be_bounded_violations = std::move(violations),
+      .banned_calls = std::move(banned_calls),
+      .limited = std::move(limited),
+      .root_causes = std::move(root_causes),
+      .skipped = skipped,
+  };
+}
+
+// How much a result matters at run time: the hottest loop that isn't
+// Bounded, or failing that, how often the function was entered.
+uint64_t hotness(const TerminationPassResult &result) {
+  uint64_t hottest = result.entry_count.value_or(0);
+  for (const LoopProfile &loop : result.loop_profiles) {
+    if (loop.elt != DoesThisTerminate::Bounded) {
+      hottest = std::max(hottest, loop.header_count);
+    }
+  }
+  return hottest;
+}
+
+// One function's entry in print<bounded-termination>.
+void printResult(llvm::raw_ostream &OS, const llvm::Function &function,
+                 const TerminationPassResult &result) {
+  OS << "Function name: " << demangled_name(function.getName()) << "\n";
+  OS << "Result: " << result.elt << "\n";
+  OS << "Explanation: " << result.explanation << "\n";
+  for (const ContendedLoop &contended : result.contended_loops) {
+    OS << "Contended: " << contended << "\n";
+  }
+  if (result.recursion) {
+    OS << "Recursion: " << *result.recursion << "\n";
+  }
+  for (const auto &[label, path] :
+       {std::pair{"Normal path: ", &result.normal_path},
+        std::pair{"Unwind path: ", &result.unwind_path}}) {
+    if (!*path) {
+      continue;
+    }
+    OS << label << (*path)->elt;
+    if (!(*path)->explanation.empty()) {
+      OS << ": " << (*path)->explanation;
+    }
+    OS << "\n";
+  }
+  if (result.stack) {
+    OS << "Stack: " << *result.stack << "\n";
+  }
+  if (result.cycles) {
+    OS << "Cycles: " << *result.cycles << "\n";
+  }
+  for (size_t k = 0; result.slow_calls && k < kSlowCallKinds; ++k) {
+    if (result.slow_calls->kinds[k].calls != 0) {
+      OS << "Slow calls: " << to_string(SlowCallKind(k)) << ": "
+         << result.slow_calls->kinds[k] << "\n";
+    }
+  }
+  if (result.entry_count) {
+    OS << "Profile: entered " << *result.entry_count << " times\n";
+  }
+  for (const LoopProfile &loop : result.loop_profiles) {
+    OS << "Profile: " << loop << "\n";
+  }
+}
+
+// Functions annotated must-be-bounded that aren't are a hard error.
+// So is a root or must-be-bounded function that may need more stack than
+// -bounded-termination-stack-limit, or take more cycles than
+// -bounded-termination-cycle-limit; and a must-be-bounded function that may
+// make a slow call of a kind in -bounded-termination-ban.
+void checkMustBeBounded(llvm::Module &IR,
+                        const ModuleTerminationPassResult &module_results) {
+  for (const llvm::Function *F : module_results.must_be_bounded_violations) {
+    const TerminationPassResult &result =
+        module_results.per_function_results.at(F);
+    const std::string message =
+        "must-be-bounded function " + demangled_name(F->getName()).str() +
+        " is " + to_string(result.elt).str() + ": " + result.explanation;
+    IR.getContext().emitError(message);
+  }
+  for (const llvm::Function *F : module_results.banned_calls) {
+    const SlowCalls &calls =
+        *module_results.per_function_results.at(F).slow_calls;
+    for (SlowCallKind kind : banned_kinds) {
+      if (calls.kinds[size_t(kind)].calls == 0) {
+        continue;
+      }
+      std::string message;
+      llvm::raw_string_ostream(message)
+          << "must-be-bounded function " << demangled_name(F->getName())
+          << " makes " << to_string(kind)
+          << " calls: " << calls.kinds[size_t(kind)];
+      IR.getContext().emitError(message);
+    }
+  }
+  for (const llvm::Function *F : module_results.limited) {
+    const TerminationPassResult &result =
+        module_results.per_function_results.at(F);
+    if (stack_limit != 0 && result.stack &&
+        (!result.stack->unbounded.empty() ||
+         result.stack->bytes > stack_limit)) {
+      std::string message;
+      llvm::raw_string_ostream(message)
+          << demangled_name(F->getName()) << " may overflow the "
+          << stack_limit << "-byte stack: " << *result.stack;
+      IR.getContext().emitError(message);
+    }
+    if (cycle_limit != 0 && result.cycles &&
+        (!result.cycles->unbounded.empty() ||
+         result.cycles->cycles > cycle_limit)) {
+      std::string message;
+      llvm::raw_string_ostream(message)
+          << demangled_name(F->getName()) << " may take more than "
+          << cycle_limit << " cycles: " << *result.cycles;
+      IR.getContext().emitError(message);
+    }
+  }
 }
 
 llvm::PreservedAnalyses
 BoundedTerminationPrinter::run(llvm::Module &IR,
                                llvm::ModuleAnalysisManager &AM) {
   auto &module_results = AM.getResult<ModuleTerminationPass>(IR);
+  // With a profile, the hottest findings go first.
+  std::vector<std::pair<const llvm::Function *, const TerminationPassResult *>>
+      order;
+  bool profiled = false;
+  for (const auto &[function, result] : module_results.per_function_results) {
+    order.push_back({function, &result});
+    profiled |= result.entry_count.has_value();
+  }
+  if (profiled) {
+    llvm::stable_sort(order, [](const auto &a, const auto &b) {
+      const bool a_finding = a.second->elt != DoesThisTerminate::Bounded;
+      const bool b_finding = b.second->elt != DoesThisTerminate::Bounded;
+      if (a_finding != b_finding) {
+        return a_finding;
+      }
+      return hotness(*a.second) > hotness(*b.second);
+    });
+  }
+  for (const auto &[function, result] : order) {
+    printResult(OS, *function, *result);
+    OS << "\n";
+  }
+  if (!module_results.root_causes.empty()) {
+    OS << "Root causes, by functions poisoned:\n";
+    for (const RootCause &cause : module_results.root_causes) {
+      OS << "  " << cause.name << " (" << cause.elt << ") poisons "
+         << cause.poisoned << " function(s)";
+      if (cause.must_be_bounded != 0) {
+        OS << ", " << cause.must_be_bounded << " must-be-bounded";
+      }
+      OS << ": " << cause.explanation << "\n";
+    }
+    OS << "\n";
+  }
+  if (module_results.skipped != 0) {
+    OS << "Skipped " << module_results.skipped
+       << " function(s) only called from assumed functions\n";
+  }
+  checkMustBeBounded(IR, module_results);
+
+  return llvm::PreservedAnalyses::all();
+}
+
+llvm::PreservedAnalyses
+BoundedTerminationRemarks::run(llvm::Module &IR,
+                               llvm::ModuleAnalysisManager &AM) {
+  if (only_if_requested && !remarks_requested(IR.getContext())) {
+    return llvm::PreservedAnalyses::all();
+  }
+  auto &module_results = AM.getResult<ModuleTerminationPass>(IR);
+  auto &FAM =
+      AM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(IR).getManager();
+  for (const auto &[function, result] : module_results.per_function_results) {
+    if (function->isDeclaration()) {
+      continue;
+    }
+    auto &F = const_cast<llvm::Function &>(*function);
+    auto &ORE = FAM.getResult<llvm::OptimizationRemarkEmitterAnalysis>(F);
+    ORE.emit([&] {
+      llvm::OptimizationRemarkAnalysis remark("bounded-termination",
+                                              to_string(result.elt), &F);
+      remark << llvm::ore::NV("Function", &F) << " is "
+             << llvm::ore::NV("Result", to_string(result.elt));
+      if (!result.explanation.empty()) {
+        remark << ": " << llvm::ore::NV("Explanation", result.explanation);
+      }
+      return remark;
+    });
+    for (const ContendedLoop &contended : result.contended_loops) {
+      ORE.emit([&] {
+        std::string message;
+        llvm::raw_string_ostream(message) << contended;
+        return llvm::OptimizationRemarkAnalysis("bounded-termination",
+                                                "Contended", &F)
+               << llvm::ore::NV("Contended", message);
+      });
+    }
+    if (result.stack) {
+      ORE.emit([&] {
+        std::string message;
+        llvm::raw_string_ostream(message) << *result.stack;
+        return llvm::OptimizationRemarkAnalysis("bounded-termination",
+                                                "Stack", &F)
+               << llvm::ore::NV("Stack", message);
+      });
+    }
+    if (result.cycles) {
+      ORE.emit([&] {
+        std::string message;
+        llvm::raw_string_ostream(message) << *result.cycles;
+        return llvm::OptimizationRemarkAnalysis("bounded-termination",
+                                                "Cycles", &F)
+               << llvm::ore::NV("Cycles", message);
+      });
+    }
+    for (size_t k = 0; result.slow_calls && k < kSlowCallKinds; ++k) {
+      if (result.slow_calls->kinds[k].calls == 0) {
+        continue;
+      }
+      ORE.emit([&] {
+        std::string message;
+        llvm::raw_string_ostream(message)
+            << to_string(SlowCallKind(k)) << ": "
+            << result.slow_calls->kinds[k];
+        return llvm::OptimizationRemarkAnalysis("bounded-termination",
+                                                "SlowCalls", &F)
+               << llvm::ore::NV("SlowCalls", message);
+      });
+    }
+    if (result.recursion) {
+      ORE.emit([&] {
+        return llvm::OptimizationRemarkAnalysis("bounded-termination",
+                                                "Recursion", &F)
+               << "recursion is at most "
+               << llvm::ore::NV("Depth", result.recursion->depth)
+               << " calls deep, "
+               << llvm::ore::NV("StackBytes", result.recursion->stack_bytes)
+               << " bytes of locals";
+      });
+    }
+  }
+  checkMustBeBounded(IR, module_results);
+
+  return llvm::PreservedAnalyses::all();
+}
+
+llvm::PreservedAnalyses
+BoundedTerminationBaselineWriter::run(llvm::Module &IR,
+                                      llvm::ModuleAnalysisManager &AM) {
+  auto &module_results = AM.getResult<ModuleTerminationPass>(IR);
+  const TerminationAnnotations &annotations =
+      AM.getResult<TerminationAnnotationsAnalysis>(IR);
+  std::error_code error;
+  llvm::raw_fd_ostream os(baseline_path, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    IR.getContext().emitError("save<bounded-termination>: can't write " +
+                              baseline_path + ": " + error.message());
+    return llvm::PreservedAnalyses::all();
+  }
+
+  const llvm::StringMap<uint64_t> fingerprints = function_fingerprints(IR);
+  // Functions we skipped are saved as Unevaluated.
+  const TerminationPassResult skipped;
+  os << "# " << baseline_settings() << "\n";
+  for (const llvm::Function &F : IR) {
+    if (!F.hasName()) {
+      continue;
+    }
+    auto it = module_results.per_function_results.find(&F);
+    const TerminationPassResult &result =
+        it != module_results.per_function_results.end() ? it->second
+                                                         : skipped;
+    os << F.getName() << "\t" << result.elt << "\t"
+       << llvm::utohexstr(baseline_fingerprint(F, fingerprints, annotations))
+       << "\t" << result.explanation << "\n";
+  }
+  return llvm::PreservedAnalyses::all();
+}
+
+llvm::PreservedAnalyses
+BoundedTerminationDiff::run(llvm::Module &IR,
+                            llvm::ModuleAnalysisManager &AM) {
+  llvm::Expected<Baseline> baseline = read_baseline(baseline_path);
+  if (!baseline) {
+    IR.getContext().emitError("diff<bounded-termination>: " +
+                              llvm::toString(baseline.takeError()));
+    return llvm::PreservedAnalyses::all();
+  }
+  const ModuleTerminationPass::Pinned pinned = pin_unchanged(
+      IR, *baseline, AM.getResult<TerminationAnnotationsAnalysis>(IR),
+      AM.getResult<llvm::CallGraphAnalysis>(IR),
+      AM.getResult<IndirectCallTargetsAnalysis>(IR));
+  // Not cached: the pinned results are only good for this comparison.
+  const ModuleTerminationPassResult module_results =
+      ModuleTerminationPass(&pinned).run(IR, AM);
+
+  struct Move {
+    const llvm::Function *function;
+    const TerminationPassResult *result;
+    // Unevaluated for a function that's new since the baseline.
+    DoesThisTerminate was;
+    bool is_new;
+    bool regressed;
+  };
+  std::vector<Move> moves;
   for (const auto &[function, result] : module_results.per_function_results) {
-    OS << "Function name: " << llvm::demangle(function->getName()) << "\n";
-    OS << "Result: " << result.elt << "\n";
-    OS << "Explanation: " << result.explanation << "\n\n";
+    if (pinned.count(function)) {
+      continue;
+    }
+    auto saved = baseline->functions.find(function->getName());
+    const bool is_new = saved == baseline->functions.end();
+    const DoesThisTerminate was =
+        is_new ? DoesThisTerminate::Unevaluated : saved->second.elt;
+    if (result.elt == was ||
+        (is_new && result.elt == DoesThisTerminate::Bounded)) {
+      continue;
+    }
+    const bool regressed = result.elt != DoesThisTerminate::Bounded &&
+                           (was == DoesThisTerminate::Bounded || is_new);
+    moves.push_back({function, &result, was, is_new, regressed});
   }
+  llvm::stable_sort(moves, [](const Move &a, const Move &b) {
+    return a.regressed > b.regressed;
+  });
 
+  size_t regressions = 0;
+  for (const Move &move : moves) {
+    regressions += move.regressed;
+    OS << "Function name: " << demangled_name(move.function->getName())
+       << "\n";
+    OS << "Result: ";
+    if (move.is_new) {
+      OS << "(new)";
+    } else {
+      OS << move.was;
+    }
+    OS << " -> " << move.result->elt
+       << (move.regressed ? " (regressed)" : "") << "\n";
+    OS << "Explanation: " << move.result->explanation << "\n\n";
+  }
+  OS << regressions << " regression(s), " << moves.size() - regressions
+     << " other change(s); " << pinned.size()
+     << " function(s) unchanged since the baseline weren't analyzed again\n";
+  if (regressions != 0) {
+    IR.getContext().emitError("diff<bounded-termination>: " +
+                              llvm::Twine(regressions) +
+                              " function(s) regressed from Bounded");
+  }
   return llvm::PreservedAnalyses::all();
 }
 
@@ -506,18 +4632,265 @@ llvm::PreservedAnalyses
 FunctionBoundedTerminationPrinter::run(llvm::Function &IR,
                                        llvm::FunctionAnalysisManager &AM) {
   auto &results = AM.getResult<FunctionTerminationPass>(IR);
-  OS << "For function: " << llvm::demangle(IR.getName())
+  OS << "For function: " << demangled_name(IR.getName())
      << "got result: " << results.elt << "\n";
 
   return llvm::PreservedAnalyses::all();
 }
 
+llvm::PreservedAnalyses
+BoundedTerminationAnnotator::run(llvm::Function &F,
+                                 llvm::FunctionAnalysisManager &FAM) {
+  const auto &result = FAM.getResult<FunctionTerminationPass>(F);
+  llvm::LLVMContext &context = F.getContext();
+  llvm::Type *i8 = llvm::Type::getInt8Ty(context);
+  size_t i = 0;
+  for (llvm::BasicBlock &BB : F) {
+    if (i >= result.block_elts.size()) {
+      break;
+    }
+    const auto elt = static_cast<uint64_t>(result.block_elts[i++]);
+    if (llvm::Instruction *terminator = BB.getTerminator()) {
+      terminator->setMetadata(
+          kTerminationMetadata,
+          llvm::MDNode::get(context, {llvm::ConstantAsMetadata::get(
+                                         llvm::ConstantInt::get(i8, elt))}));
+    }
+  }
+  // Only metadata changed.
+  return llvm::PreservedAnalyses::all();
+}
+
+std::string ResidentModule::refresh(bool force) {
+  llvm::sys::fs::file_status status;
+  if (std::error_code error = llvm::sys::fs::status(path, status)) {
+    return "Can't read " + path + ": " + error.message();
+  }
+  if (loaded() && !force && status.getLastModificationTime() == modified) {
+    return "";
+  }
+  modified = status.getLastModificationTime();
+
+  auto next_context = std::make_unique<llvm::LLVMContext>();
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> next =
+      llvm::parseIRFile(path, diagnostic, *next_context);
+  if (!next) {
+    std::string message;
+    llvm::raw_string_ostream os(message);
+    diagnostic.print("serve<bounded-termination>", os, /*ShowColors=*/false);
+    return os.str();
+  }
+
+  // A function whose code changed is analyzed again, and so are its callers,
+  // which may have relied on its attributes. The rest keep their results.
+  llvm::StringMap<uint64_t> next_fingerprints = function_fingerprints(*next);
+  llvm::StringSet<> stale;
+  for (const llvm::Function &F : *next) {
+    if (auto it = fingerprints.find(F.getName());
+        it != fingerprints.end() &&
+        it->second == next_fingerprints.lookup(F.getName())) {
+      continue;
+    }
+    stale.insert(F.getName());
+    for (const llvm::User *user : F.users()) {
+      if (const auto *call = llvm::dyn_cast<llvm::CallBase>(user)) {
+        stale.insert(call->getFunction()->getName());
+      }
+    }
+  }
+  carried.clear();
+  if (loaded()) {
+    for (const llvm::Function &F : *next) {
+      const llvm::Function *old = module->getFunction(F.getName());
+      if (!F.hasName() || stale.contains(F.getName()) || old == nullptr) {
+        continue;
+      }
+      if (const auto *result =
+              analyses->FAM.getCachedResult<FunctionTerminationPass>(
+                  const_cast<llvm::Function &>(*old))) {
+        carried.insert({&F, rebase(*result, *old, F)});
+      }
+    }
+  }
+
+  analyses.reset();
+  module.reset();
+  context = std::move(next_context);
+  module = std::move(next);
+  fingerprints = std::move(next_fingerprints);
+
+  analyses = std::make_unique<Analyses>();
+  Analyses &A = *analyses;
+  // Registered first, so it's the one that sticks.
+  A.FAM.registerPass([&] { return FunctionTerminationPass(&carried); });
+  getBoundedTerminationPassPluginInfo().RegisterPassBuilderCallbacks(A.PB);
+  A.PB.registerModuleAnalyses(A.MAM);
+  A.PB.registerCGSCCAnalyses(A.CGAM);
+  A.PB.registerFunctionAnalyses(A.FAM);
+  A.PB.registerLoopAnalyses(A.LAM);
+  A.PB.crossRegisterProxies(A.LAM, A.FAM, A.CGAM, A.MAM);
+  A.MAM.getResult<ModuleTerminationPass>(*module);
+
+  size_t analyzed = 0;
+  for (const llvm::Function &F : *module) {
+    analyzed += !F.isDeclaration() && carried.count(&F) == 0;
+  }
+  // The FAM has them all now.
+  carried.clear();
+  return "Read " + path + ": analyzed " + std::to_string(analyzed) +
+         " function(s)";
+}
+
+void ResidentModule::query(llvm::StringRef name, llvm::raw_ostream &os) {
+  const auto &module_results =
+      analyses->MAM.getResult<ModuleTerminationPass>(*module);
+  const llvm::Function *F = module->getFunction(name);
+  for (auto it = module->begin(); F == nullptr && it != module->end(); ++it) {
+    if (demangled_name(it->getName()) == name) {
+      F = &*it;
+    }
+  }
+  if (F == nullptr) {
+    os << "No function named " << name << "\n";
+    return;
+  }
+  auto it = module_results.per_function_results.find(F);
+  if (it == module_results.per_function_results.end()) {
+    os << "Function name: " << demangled_name(F->getName()) << "\n";
+    os << "Not analyzed: only called from assumed functions\n";
+    return;
+  }
+  printResult(os, *F, it->second);
+}
+
+#ifdef LLVM_ON_UNIX
+// Answers one client's requests, until it hangs up.
+// Returns false if it asked us to shut down.
+bool serveClient(int client, ResidentModule &resident) {
+  std::string pending;
+  char buffer[4096];
+  while (true) {
+    size_t newline;
+    while ((newline = pending.find('\n')) == std::string::npos) {
+      const ssize_t n = ::read(client, buffer, sizeof(buffer));
+      if (n <= 0) {
+        return true;
+      }
+      pending.append(buffer, n);
+    }
+    const std::string line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    auto [command, argument] = llvm::StringRef(line).trim().split(' ');
+    argument = argument.trim();
+
+    std::string reply;
+    llvm::raw_string_ostream os(reply);
+    const bool shutdown = command == "shutdown";
+    if (!shutdown) {
+      const std::string refreshed = resident.refresh(command == "reload");
+      if (!refreshed.empty()) {
+        os << refreshed << "\n";
+      }
+    }
+    if (command == "query") {
+      resident.query(argument, os);
+    } else if (shutdown) {
+      os << "Shutting down\n";
+    } else if (command != "reload") {
+      os << "Unknown request '" << command
+         << "'; try query <function>, reload, or shutdown\n";
+    }
+    os << "\n";
+    llvm::StringRef rest = os.str();
+    while (!rest.empty()) {
+      const ssize_t n = ::write(client, rest.data(), rest.size());
+      if (n <= 0) {
+        return !shutdown;
+      }
+      rest = rest.drop_front(n);
+    }
+    if (shutdown) {
+      return false;
+    }
+  }
+}
+#endif
+
+llvm::PreservedAnalyses
+BoundedTerminationDaemon::run(llvm::Module &IR,
+                              llvm::ModuleAnalysisManager &) {
+#ifdef LLVM_ON_UNIX
+  // We keep our own copy of the module, so we can swap in a new one.
+  ResidentModule resident(IR.getModuleIdentifier());
+  const std::string loaded = resident.refresh(/*force=*/true);
+  if (!resident.loaded()) {
+    IR.getContext().emitError("serve<bounded-termination>: " + loaded);
+    return llvm::PreservedAnalyses::all();
+  }
+
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+    IR.getContext().emitError("serve<bounded-termination>: can't listen on " +
+                              socket_path);
+    return llvm::PreservedAnalyses::all();
+  }
+  std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  // Clear away a socket an earlier daemon left behind; anything else at that
+  // path is someone's file, and bind will say so.
+  struct stat existing;
+  if (::lstat(socket_path.c_str(), &existing) == 0 &&
+      S_ISSOCK(existing.st_mode)) {
+    ::unlink(socket_path.c_str());
+  }
+  if (::bind(listener, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener, /*backlog=*/8) != 0) {
+    IR.getContext().emitError("serve<bounded-termination>: can't listen on " +
+                              socket_path + ": " + std::strerror(errno));
+    ::close(listener);
+    return llvm::PreservedAnalyses::all();
+  }
+  // A client that hangs up mid-reply shouldn't take us down with it.
+  std::signal(SIGPIPE, SIG_IGN);
+  llvm::errs() << loaded << "; listening on " << socket_path << "\n";
+
+  bool serving = true;
+  while (serving) {
+    const int client = ::accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    serving = serveClient(client, resident);
+    ::close(client);
+  }
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+#else
+  IR.getContext().emitError(
+      "serve<bounded-termination> needs Unix-domain sockets");
+#endif
+  return llvm::PreservedAnalyses::all();
+}
+
 //------------------------------------------------------------------------------
 // Static / wiring
 //------------------------------------------------------------------------------
 
 llvm::AnalysisKey FunctionTerminationPass::Key;
 llvm::AnalysisKey ModuleTerminationPass::Key;
+llvm::AnalysisKey TerminationAnnotationsAnalysis::Key;
+llvm::AnalysisKey IndirectCallTargetsAnalysis::Key;
+llvm::AnalysisKey RecursionBoundsAnalysis::Key;
+llvm::AnalysisKey CallGroupsAnalysis::Key;
+llvm::AnalysisKey StackBoundsAnalysis::Key;
+llvm::AnalysisKey CycleCostsAnalysis::Key;
+llvm::AnalysisKey SlowCallsAnalysis::Key;
 
 llvm::PassPluginLibraryInfo getBoundedTerminationPassPluginInfo() {
   using namespace ::llvm;
@@ -530,6 +4903,22 @@ llvm::PassPluginLibraryInfo getBoundedTerminationPassPluginInfo() {
                     PM.addPass(BoundedTerminationPrinter(llvm::errs()));
                     return true;
                   }
+                  if (Name == "remark<bounded-termination>") {
+                    PM.addPass(BoundedTerminationRemarks());
+                    return true;
+                  }
+                  if (Name == "save<bounded-termination>") {
+                    PM.addPass(BoundedTerminationBaselineWriter());
+                    return true;
+                  }
+                  if (Name == "diff<bounded-termination>") {
+                    PM.addPass(BoundedTerminationDiff(llvm::errs()));
+                    return true;
+                  }
+                  if (Name == "serve<bounded-termination>") {
+                    PM.addPass(BoundedTerminationDaemon());
+                    return true;
+                  }
                   return false;
                 });
             PB.registerPipelineParsingCallback(
@@ -539,15 +4928,35 @@ llvm::PassPluginLibraryInfo getBoundedTerminationPassPluginInfo() {
                     PM.addPass(FunctionBoundedTerminationPrinter(llvm::errs()));
                     return true;
                   }
+                  if (Name == "annotate<bounded-termination>") {
+                    PM.addPass(BoundedTerminationAnnotator());
+                    return true;
+                  }
                   return false;
                 });
+            // Run in-process with `clang -fpass-plugin`, after optimization.
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &PM, OptimizationLevel) {
+                  PM.addPass(
+                      BoundedTerminationRemarks(/*only_if_requested=*/true));
+                });
             PB.registerAnalysisRegistrationCallback(
                 [](FunctionAnalysisManager &AM) {
                   AM.registerPass([&] { return FunctionTerminationPass(); });
+                  AM.registerPass([&] { return SCCLoopPass(); });
                 });
             PB.registerAnalysisRegistrationCallback(
                 [](ModuleAnalysisManager &AM) {
                   AM.registerPass([&] { return ModuleTerminationPass(); });
+                  AM.registerPass(
+                      [&] { return TerminationAnnotationsAnalysis(); });
+                  AM.registerPass(
+                      [&] { return IndirectCallTargetsAnalysis(); });
+                  AM.registerPass([&] { return RecursionBoundsAnalysis(); });
+                  AM.registerPass([&] { return CallGroupsAnalysis(); });
+                  AM.registerPass([&] { return StackBoundsAnalysis(); });
+                  AM.registerPass([&] { return CycleCostsAnalysis(); });
+                  AM.registerPass([&] { return SlowCallsAnalysis(); });
                 });
           }};
 };
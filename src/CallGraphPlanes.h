@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Bit-parallel propagation over a call graph
+//------------------------------------------------------------------------------
+//
+// A termination result fits in two bits:
+//   bit 0 ("lo"): some path through this may terminate  (Bounded)
+//   bit 1 ("hi"): some path through this may not        (Unbounded)
+// so Unevaluated is 0b00, Unknown is 0b11, `join` is bitwise-or, and
+// `transfer` is one and plus one or.
+//
+// Rather than one struct per function, we keep one bit per function in each
+// of two "planes", 64 functions to a word, and apply the join/transfer rules a
+// whole word at a time.
+
+constexpr unsigned kMayTerminate = 0b01;
+constexpr unsigned kMayDiverge = 0b10;
+
+// Call graph in compressed-sparse-row form:
+// the callees of node `i` are `callees[offsets[i]] .. callees[offsets[i+1]]`.
+struct CSRCallGraph {
+  std::vector<uint32_t> offsets = {0};
+  std::vector<uint32_t> callees;
+  // One bit per node: set if the node calls something we can't see
+  // (an indirect call, or a call out of the module).
+  std::vector<uint64_t> calls_unknown;
+
+  size_t size() const { return offsets.size() - 1; }
+
+  // Nodes must be added in order; add all edges of node N before node N+1.
+  void add_edge(uint32_t callee) { callees.push_back(callee); }
+  void add_unknown_edge() {
+    size_t node = size();
+    if (calls_unknown.size() <= node / 64) {
+      calls_unknown.resize(node / 64 + 1);
+    }
+    calls_unknown[node / 64] |= uint64_t(1) << (node % 64);
+  }
+  void finish_node() { offsets.push_back(callees.size()); }
+};
+
+// Number of words we process together.
+// With vector extensions available, this is one 256-bit operation per plane.
+constexpr size_t kPlaneLanes = 4;
+
+struct LatticePlanes {
+  std::vector<uint64_t> lo;
+  std::vector<uint64_t> hi;
+
+  explicit LatticePlanes(size_t nodes)
+      : lo(padded_words(nodes)), hi(padded_words(nodes)) {}
+
+  unsigned get(size_t node) const {
+    const unsigned l = (lo[node / 64] >> (node % 64)) & 1;
+    const unsigned h = (hi[node / 64] >> (node % 64)) & 1;
+    return l | (h << 1);
+  }
+
+  void set(size_t node, unsigned value) {
+    const uint64_t mask = uint64_t(1) << (node % 64);
+    lo[node / 64] = (value & kMayTerminate) ? (lo[node / 64] | mask)
+                                            : (lo[node / 64] & ~mask);
+    hi[node / 64] = (value & kMayDiverge) ? (hi[node / 64] | mask)
+                                          : (hi[node / 64] & ~mask);
+  }
+
+private:
+  static size_t padded_words(size_t nodes) {
+    size_t words = (nodes + 63) / 64;
+    return (words + kPlaneLanes - 1) / kPlaneLanes * kPlaneLanes;
+  }
+};
+
+// `transfer` (see TerminationLattice.h), applied to every bit of a word:
+// we can terminate if both this and what comes after can,
+// and diverge if either can.
+//
+// Templated so it works on both plain words and vector-extension lanes.
+template <typename Word>
+constexpr void transfer_planes(Word &lo, Word &hi, Word after_lo,
+                               Word after_hi) {
+  lo = lo & after_lo;
+  hi = hi | after_hi;
+}
+
+// Set `lo`/`hi` to transfer(local, after), kPlaneLanes words at once.
+// Returns true if any bit changed.
+inline bool transfer_lanes(uint64_t *lo, uint64_t *hi,
+                           const uint64_t *local_lo, const uint64_t *local_hi,
+                           const uint64_t *after_lo, const uint64_t *after_hi) {
+#if defined(__GNUC__) || defined(__clang__)
+  // Lowered to SSE/AVX or NEON where the target has them,
+  // and to scalar operations where it doesn't.
+  typedef uint64_t Lanes
+      __attribute__((vector_size(sizeof(uint64_t) * kPlaneLanes)));
+  Lanes r_lo, r_hi, old_lo, old_hi, in_lo, in_hi;
+  __builtin_memcpy(&r_lo, local_lo, sizeof(Lanes));
+  __builtin_memcpy(&r_hi, local_hi, sizeof(Lanes));
+  __builtin_memcpy(&old_lo, lo, sizeof(Lanes));
+  __builtin_memcpy(&old_hi, hi, sizeof(Lanes));
+  __builtin_memcpy(&in_lo, after_lo, sizeof(Lanes));
+  __builtin_memcpy(&in_hi, after_hi, sizeof(Lanes));
+  transfer_planes(r_lo, r_hi, in_lo, in_hi);
+  const Lanes diff = (r_lo ^ old_lo) | (r_hi ^ old_hi);
+  __builtin_memcpy(lo, &r_lo, sizeof(Lanes));
+  __builtin_memcpy(hi, &r_hi, sizeof(Lanes));
+  uint64_t any = 0;
+  for (size_t i = 0; i < kPlaneLanes; ++i) {
+    any |= diff[i];
+  }
+  return any != 0;
+#else
+  uint64_t any = 0;
+  for (size_t i = 0; i < kPlaneLanes; ++i) {
+    uint64_t r_lo = local_lo[i], r_hi = local_hi[i];
+    transfer_planes(r_lo, r_hi, after_lo[i], after_hi[i]);
+    any |= (lo[i] ^ r_lo) | (hi[i] ^ r_hi);
+    lo[i] = r_lo;
+    hi[i] = r_hi;
+  }
+  return any != 0;
+#endif
+}
+
+// Iterate `value = transfer(local, join(callee values))` to a fixpoint,
+// starting from `value = local`.
+// A node with no callees keeps its local value.
+//
+// Nodes should be numbered callees-first (scc_iterator order) so that almost
+// every callee is final by the time its callers are visited; then this
+// converges in a couple of sweeps.
+//
+// Returns the number of sweeps it took.
+inline unsigned propagate_planes(const CSRCallGraph &G, LatticePlanes &P) {
+  const size_t nodes = G.size();
+  const size_t words = P.lo.size();
+  const LatticePlanes local = P;
+  unsigned sweeps = 0;
+  bool stale = true;
+  while (stale) {
+    stale = false;
+    ++sweeps;
+    for (size_t base = 0; base < words; base += kPlaneLanes) {
+      uint64_t after_lo[kPlaneLanes] = {};
+      uint64_t after_hi[kPlaneLanes] = {};
+      // Gather: join over the callees of each node in this block.
+      for (size_t lane = 0; lane < kPlaneLanes; ++lane) {
+        const size_t word = base + lane;
+        uint64_t unknown = 0;
+        if (word < G.calls_unknown.size()) {
+          unknown = G.calls_unknown[word];
+        }
+        after_lo[lane] = after_hi[lane] = unknown;
+        for (size_t bit = 0; bit < 64; ++bit) {
+          const size_t node = word * 64 + bit;
+          if (node >= nodes) {
+            break;
+          }
+          uint64_t l = 0, h = 0;
+          if (G.offsets[node] == G.offsets[node + 1] &&
+              !((unknown >> bit) & 1)) {
+            // Nothing after this: transfer(local, Bounded) == local.
+            l = 1;
+          }
+          for (uint32_t e = G.offsets[node]; e < G.offsets[node + 1]; ++e) {
+            const uint32_t callee = G.callees[e];
+            l |= P.lo[callee / 64] >> (callee % 64);
+            h |= P.hi[callee / 64] >> (callee % 64);
+          }
+          after_lo[lane] |= (l & 1) << bit;
+          after_hi[lane] |= (h & 1) << bit;
+        }
+      }
+      // Apply: 64 * kPlaneLanes nodes at once.
+      if (transfer_lanes(&P.lo[base], &P.hi[base], &local.lo[base],
+                         &local.hi[base], after_lo, after_hi)) {
+        stale = true;
+      }
+    }
+  }
+  return sweeps;
+}
+
+// Strongly-connected components of the call graph, by Tarjan's algorithm
+// (iteratively, since call chains can be deep). Components are numbered as
+// they're finished, callees first.
+struct CSRComponents {
+  // The component of each node.
+  std::vector<uint32_t> component;
+  // Whether each component contains a cycle: more than one node, or a node
+  // that calls itself.
+  std::vector<bool> cyclic;
+};
+
+inline CSRComponents strongly_connected(const CSRCallGraph &G) {
+  constexpr uint32_t kUnvisited = ~0u;
+  const size_t nodes = G.size();
+  CSRComponents result;
+  result.component.assign(nodes, kUnvisited);
+  std::vector<uint32_t> index(nodes, kUnvisited), low(nodes);
+  std::vector<uint32_t> stack;
+  // (node, next edge to follow)
+  std::vector<std::pair<uint32_t, uint32_t>> frames;
+  uint32_t next_index = 0;
+  for (uint32_t start = 0; start < nodes; ++start) {
+    if (index[start] != kUnvisited) {
+      continue;
+    }
+    frames.push_back({start, G.offsets[start]});
+    index[start] = low[start] = next_index++;
+    stack.push_back(start);
+    while (!frames.empty()) {
+      auto &[n, e] = frames.back();
+      if (e < G.offsets[n + 1]) {
+        const uint32_t callee = G.callees[e++];
+        if (index[callee] == kUnvisited) {
+          index[callee] = low[callee] = next_index++;
+          stack.push_back(callee);
+          frames.push_back({callee, G.offsets[callee]});
+        } else if (result.component[callee] == kUnvisited &&
+                   index[callee] < low[n]) {
+          // Still on the stack: part of the component being built.
+          low[n] = index[callee];
+        }
+        continue;
+      }
+      const uint32_t finished = n;
+      frames.pop_back();
+      if (!frames.empty()) {
+        const uint32_t caller = frames.back().first;
+        if (low[finished] < low[caller]) {
+          low[caller] = low[finished];
+        }
+      }
+      if (low[finished] != index[finished]) {
+        continue;
+      }
+      const uint32_t component = result.cyclic.size();
+      uint32_t member;
+      bool cyclic = false;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        result.component[member] = component;
+        cyclic |= member != finished;
+      } while (member != finished);
+      result.cyclic.push_back(cyclic);
+    }
+  }
+  // A single node is only a cycle if it calls itself.
+  for (uint32_t n = 0; n < nodes; ++n) {
+    for (uint32_t e = G.offsets[n]; e < G.offsets[n + 1]; ++e) {
+      if (G.callees[e] == n) {
+        result.cyclic[result.component[n]] = true;
+      }
+    }
+  }
+  return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Path.h"
+#include <string>
+
+//------------------------------------------------------------------------------
+// The termination checker, as a plugin for a standalone driver
+//------------------------------------------------------------------------------
+//
+// LazyCheck and MachineCheck load BoundedTerminationPass the way opt loads
+// -load-pass-plugin: before the command line is parsed, so that the plugin's
+// own options (-bounded-termination-unwind, ...) are there to be parsed too.
+// The drivers still declare -load-pass-plugin, so that parsing accepts it.
+
+// The value of -load-pass-plugin (or --load-pass-plugin), as `-x=value` or
+// `-x value`; otherwise BoundedTerminationPass next to the driver.
+inline std::string plugin_argument(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg = argv[i];
+    if (!arg.consume_front("--")) {
+      arg.consume_front("-");
+    }
+    if (arg == "load-pass-plugin" && i + 1 < argc) {
+      return argv[i + 1];
+    }
+    if (arg.consume_front("load-pass-plugin=")) {
+      return arg.str();
+    }
+  }
+  llvm::SmallString<128> path(llvm::sys::path::parent_path(argv[0]));
+#ifdef __APPLE__
+  llvm::sys::path::append(path, "BoundedTerminationPass.dylib");
+#else
+  llvm::sys::path::append(path, "BoundedTerminationPass.so");
+#endif
+  return std::string(path);
+}
+
+// Call before llvm::cl::ParseCommandLineOptions.
+inline llvm::Expected<llvm::PassPlugin> load_plugin(int argc, char **argv) {
+  return llvm::PassPlugin::Load(plugin_argument(argc, argv));
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Lattices
+//------------------------------------------------------------------------------
+//
+// A domain for the solvers below provides:
+//
+//   using Value = ...;
+//   static Value bottom();
+//   static Value join(Value, Value);
+//   // The value of a node, given its own (local) value and the join of
+//   // everything after it. Only called for nodes that have successors.
+//   static Value transfer(Value local, Value after);
+//
+// and Value must be equality-comparable. `transfer` must be monotone in both
+// arguments for the solvers to converge.
+//
+// Small, finite domains are best written as an enum plus two tables;
+// `TableLattice` turns those into branch-free lookups, and the `is_*`
+// functions below let the domain check its tables with static_assert.
+
+template <typename E, size_t N>
+using LatticeTable = std::array<std::array<E, N>, N>;
+
+namespace lattice_detail {
+template <typename E> constexpr size_t idx(E e) {
+  return static_cast<size_t>(e);
+}
+} // namespace lattice_detail
+
+// join is commutative, associative, and idempotent, with `bottom` as identity.
+template <typename E, size_t N>
+constexpr bool is_semilattice(const LatticeTable<E, N> &join, E bottom) {
+  using lattice_detail::idx;
+  for (size_t a = 0; a < N; ++a) {
+    if (join[a][a] != E(a) || join[a][idx(bottom)] != E(a)) {
+      return false;
+    }
+    for (size_t b = 0; b < N; ++b) {
+      if (join[a][b] != join[b][a]) {
+        return false;
+      }
+      for (size_t c = 0; c < N; ++c) {
+        if (join[idx(join[a][b])][c] != join[a][idx(join[b][c])]) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// a <= b in the order induced by join.
+template <typename E, size_t N>
+constexpr bool leq(const LatticeTable<E, N> &join, E a, E b) {
+  using lattice_detail::idx;
+  return join[idx(a)][idx(b)] == b;
+}
+
+// op(a, b) <= op(a', b') whenever a <= a' and b <= b'.
+template <typename E, size_t N>
+constexpr bool is_monotone(const LatticeTable<E, N> &join,
+                           const LatticeTable<E, N> &op) {
+  for (size_t a = 0; a < N; ++a) {
+    for (size_t a2 = 0; a2 < N; ++a2) {
+      if (!leq(join, E(a), E(a2))) {
+        continue;
+      }
+      for (size_t b = 0; b < N; ++b) {
+        for (size_t b2 = 0; b2 < N; ++b2) {
+          if (leq(join, E(b), E(b2)) && !leq(join, op[a][b], op[a2][b2])) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Adapts a table-driven domain to the solver interface.
+//
+// Domain provides:
+//   using Value = <enum>;
+//   static constexpr size_t kSize;
+//   static constexpr Value kBottom;
+//   static constexpr LatticeTable<Value, kSize> kJoin, kTransfer;
+template <typename Domain> struct TableLattice {
+  using Value = typename Domain::Value;
+
+  static constexpr Value bottom() { return Domain::kBottom; }
+  static constexpr Value join(Value a, Value b) {
+    return Domain::kJoin[lattice_detail::idx(a)][lattice_detail::idx(b)];
+  }
+  static constexpr Value transfer(Value local, Value after) {
+    return Domain::kTransfer[lattice_detail::idx(local)]
+                            [lattice_detail::idx(after)];
+  }
+  static constexpr bool leq(Value a, Value b) { return join(a, b) == b; }
+
+  static_assert(is_semilattice(Domain::kJoin, Domain::kBottom),
+                "join must be a semilattice with bottom as identity");
+  static_assert(is_monotone(Domain::kJoin, Domain::kJoin),
+                "join must be monotone");
+  static_assert(is_monotone(Domain::kJoin, Domain::kTransfer),
+                "transfer must be monotone");
+};
+
+// Worst-case cost along any path: join is max, transfer adds.
+// Saturates rather than wrapping; `kUnbounded` is top.
+struct MaxCostLattice {
+  using Value = uint64_t;
+  static constexpr Value kUnbounded = std::numeric_limits<uint64_t>::max();
+
+  static constexpr Value bottom() { return 0; }
+  static constexpr Value join(Value a, Value b) { return std::max(a, b); }
+  static constexpr Value transfer(Value local, Value after) {
+    return (after > kUnbounded - local) ? kUnbounded : local + after;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Solvers
+//------------------------------------------------------------------------------
+
+// A graph over dense ordinals, in compressed-sparse-row form,
+// with edges in both directions.
+class DenseGraph {
+public:
+  explicit DenseGraph(size_t nodes) : nodes(nodes) {}
+
+  void add_edge(uint32_t from, uint32_t to) { edges.push_back({from, to}); }
+
+  // Call once, after all edges are added.
+  void finish() {
+    build(succ_offsets, succs, /*reverse=*/false);
+    build(pred_offsets, preds, /*reverse=*/true);
+    edges.clear();
+  }
+
+  size_t size() const { return nodes; }
+  llvm::ArrayRef<uint32_t> successors(uint32_t n) const {
+    return llvm::ArrayRef<uint32_t>(succs).slice(
+        succ_offsets[n], succ_offsets[n + 1] - succ_offsets[n]);
+  }
+  llvm::ArrayRef<uint32_t> predecessors(uint32_t n) const {
+    return llvm::ArrayRef<uint32_t>(preds).slice(
+        pred_offsets[n], pred_offsets[n + 1] - pred_offsets[n]);
+  }
+
+private:
+  void build(std::vector<uint32_t> &offsets, std::vector<uint32_t> &targets,
+             bool reverse) {
+    offsets.assign(nodes + 1, 0);
+    for (const auto &[from, to] : edges) {
+      ++offsets[(reverse ? to : from) + 1];
+    }
+    for (size_t i = 0; i < nodes; ++i) {
+      offsets[i + 1] += offsets[i];
+    }
+    targets.resize(edges.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const auto &[from, to] : edges) {
+      targets[cursor[reverse ? to : from]++] = reverse ? from : to;
+    }
+  }
+
+  size_t nodes;
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  std::vector<uint32_t> succ_offsets, succs, pred_offsets, preds;
+};
+
+// Backward dataflow to the least fixpoint:
+//   value(n) = local(n)                                  if n has no successors
+//   value(n) = transfer(local(n), join(value(s) for s))  otherwise
+template <typename L>
+std::vector<typename L::Value>
+solve_backward(const DenseGraph &G, llvm::ArrayRef<typename L::Value> local) {
+  using Value = typename L::Value;
+  std::vector<Value> value(G.size(), L::bottom());
+
+  // Start everything on the worklist; popping from the back means the nodes
+  // last in layout order (usually the exits) go first.
+  llvm::BitVector queued(G.size(), true);
+  llvm::SmallVector<uint32_t, 32> worklist;
+  worklist.reserve(G.size());
+  for (uint32_t n = 0; n < G.size(); ++n) {
+    worklist.push_back(n);
+  }
+
+  while (!worklist.empty()) {
+    const uint32_t n = worklist.pop_back_val();
+    queued.reset(n);
+
+    Value result = local[n];
+    llvm::ArrayRef<uint32_t> succs = G.successors(n);
+    if (!succs.empty()) {
+      Value after = L::bottom();
+      for (uint32_t s : succs) {
+        after = L::join(after, value[s]);
+      }
+      result = L::transfer(local[n], after);
+    }
+    if (result == value[n]) {
+      continue;
+    }
+    value[n] = result;
+    for (uint32_t p : G.predecessors(n)) {
+      if (!queued.test(p)) {
+        queued.set(p);
+        worklist.push_back(p);
+      }
+    }
+  }
+  return value;
+}
@@ -0,0 +1,314 @@
+
+// Checks a few functions of a big bitcode file without loading all of it:
+//
+//   LazyCheck -root isr -root main program.bc
+//
+// Function bodies are only read from disk once a walk from the roots reaches
+// them; everything else is left as a declaration. Then the termination
+// checker (loaded as a plugin, as with opt) runs on what's left.
+//
+// One difference from running on the whole module: an indirect call whose
+// candidates are found module-wide (by a type test on the called pointer, or
+// by its type with -bounded-termination-whole-program) can't tell which
+// functions have their address taken without reading every body. So every
+// function of the called type is read, and kept as a candidate (through
+// llvm.compiler.used). There may be more candidates than in the whole-module
+// run, never fewer: a verdict can only be less certain.
+
+#include "DriverPlugin.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalIFunc.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    input_file(llvm::cl::Positional, llvm::cl::desc("<input bitcode>"),
+               llvm::cl::Required);
+
+static llvm::cl::list<std::string>
+    roots("root",
+          llvm::cl::desc("Function to check, along with everything it "
+                         "reaches (mangled name)"),
+          llvm::cl::OneOrMore);
+
+// Read by load_plugin, before parsing; see DriverPlugin.h.
+static llvm::cl::opt<std::string> plugin_path(
+    "load-pass-plugin",
+    llvm::cl::desc("Termination checker plugin (default: "
+                   "BoundedTerminationPass next to this program)"));
+
+static llvm::cl::opt<std::string>
+    passes("passes", llvm::cl::desc("Pipeline to run on the loaded code"),
+           llvm::cl::init("print<bounded-termination>"));
+
+//------------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------------
+
+// The plugin's -bounded-termination-whole-program, registered when it was
+// loaded.
+bool whole_program() {
+  const auto &options = llvm::cl::getRegisteredOptions();
+  auto it = options.find("bounded-termination-whole-program");
+  return it != options.end() &&
+         static_cast<llvm::cl::opt<bool> *>(it->second)->getValue();
+}
+
+// Whether the checker looks for `call`'s candidates across the module: it's
+// indirect, has no `!callees`, and its pointer is type-tested (under CFI,
+// possibly through a cast) or the module is the whole program.
+bool has_module_wide_candidates(const llvm::CallBase &call,
+                                bool whole_program) {
+  const llvm::Value *called = call.getCalledOperand()->stripPointerCasts();
+  if (call.isInlineAsm() || llvm::isa<llvm::Function>(called) ||
+      call.hasMetadata(llvm::LLVMContext::MD_callees)) {
+    return false;
+  }
+  if (whole_program) {
+    return true;
+  }
+  llvm::SmallVector<const llvm::User *, 8> users(
+      call.getCalledOperand()->users());
+  while (!users.empty()) {
+    const llvm::User *user = users.pop_back_val();
+    if (llvm::isa<llvm::BitCastInst>(user)) {
+      users.append(user->user_begin(), user->user_end());
+    } else if (const auto *test = llvm::dyn_cast<llvm::IntrinsicInst>(user);
+               test != nullptr &&
+               test->getIntrinsicID() == llvm::Intrinsic::type_test) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads the bodies of everything reachable from `roots`: what they call,
+// what they take the address of (directly, or through a global's
+// initializer), since that may be called indirectly, and what their
+// indirect calls' `!callees` lists name. Aliases and ifuncs lead to their
+// aliasee and resolver.
+// An indirect call with module-wide candidates reaches every function of
+// its type (a type identifier names one): which of them have their address
+// taken, or which `!type`, isn't known until all of them are read. They're
+// added to `candidates`, to be kept.
+// Returns the number of functions read.
+llvm::Expected<size_t>
+materialize_reachable(llvm::ArrayRef<const llvm::Function *> roots,
+                      bool whole_program,
+                      std::vector<llvm::GlobalValue *> &candidates) {
+  llvm::DenseMap<const llvm::FunctionType *,
+                 llvm::SmallVector<llvm::Function *, 4>>
+      by_type;
+  llvm::DenseSet<const llvm::FunctionType *> called_types;
+  llvm::DenseSet<const llvm::Value *> seen;
+  llvm::SmallVector<const llvm::Value *, 64> worklist;
+  auto reach = [&](const llvm::Value *V) {
+    if ((llvm::isa<llvm::Function>(V) || llvm::isa<llvm::GlobalVariable>(V) ||
+         llvm::isa<llvm::GlobalAlias>(V) || llvm::isa<llvm::GlobalIFunc>(V) ||
+         llvm::isa<llvm::ConstantExpr>(V) ||
+         llvm::isa<llvm::ConstantAggregate>(V)) &&
+        seen.insert(V).second) {
+      worklist.push_back(V);
+    }
+  };
+  for (const llvm::Function *root : roots) {
+    reach(root);
+  }
+
+  size_t materialized = 0;
+  while (!worklist.empty()) {
+    const llvm::Value *V = worklist.pop_back_val();
+    if (const auto *GV = llvm::dyn_cast<llvm::GlobalVariable>(V)) {
+      if (GV->hasInitializer()) {
+        reach(GV->getInitializer());
+      }
+      continue;
+    }
+    // Including an alias's aliasee, and an ifunc's resolver.
+    if (const auto *C = llvm::dyn_cast<llvm::Constant>(V);
+        C != nullptr && !llvm::isa<llvm::Function>(C)) {
+      for (const llvm::Value *operand : C->operands()) {
+        reach(operand);
+      }
+      continue;
+    }
+    auto *F = const_cast<llvm::Function *>(llvm::cast<llvm::Function>(V));
+    if (!F->isMaterializable()) {
+      continue;
+    }
+    if (llvm::Error error = F->materialize()) {
+      return std::move(error);
+    }
+    ++materialized;
+    for (const llvm::BasicBlock &BB : *F) {
+      for (const llvm::Instruction &I : BB) {
+        for (const llvm::Value *operand : I.operands()) {
+          reach(operand);
+        }
+        const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+        if (call != nullptr &&
+            has_module_wide_candidates(*call, whole_program) &&
+            called_types.insert(call->getFunctionType()).second) {
+          if (by_type.empty()) {
+            for (llvm::Function &G : *F->getParent()) {
+              by_type[G.getFunctionType()].push_back(&G);
+            }
+          }
+          for (llvm::Function *G : by_type.lookup(call->getFunctionType())) {
+            candidates.push_back(G);
+            reach(G);
+          }
+        }
+        if (const llvm::MDNode *callees =
+                I.getMetadata(llvm::LLVMContext::MD_callees)) {
+          for (const llvm::MDOperand &op : callees->operands()) {
+            if (const auto *callee =
+                    llvm::mdconst::dyn_extract_or_null<llvm::Function>(op)) {
+              reach(callee);
+            }
+          }
+        }
+      }
+    }
+  }
+  return materialized;
+}
+
+// Turns everything we didn't read into a declaration, and drops the
+// declarations nothing refers to. An alias of a function we didn't read
+// can't stay an alias (it must point to a definition): what refers to it
+// refers to the aliasee instead. The same goes for an ifunc's resolver; an
+// ifunc like that can only be unreached, and is dropped.
+void drop_unreached(llvm::Module &M) {
+  for (llvm::Function &F : M) {
+    if (F.isMaterializable()) {
+      F.deleteBody();
+    }
+  }
+  for (llvm::GlobalAlias &A : llvm::make_early_inc_range(M.aliases())) {
+    const llvm::GlobalObject *aliasee = A.getAliaseeObject();
+    if (aliasee != nullptr && aliasee->isDeclaration()) {
+      A.replaceAllUsesWith(A.getAliasee());
+      A.eraseFromParent();
+    }
+  }
+  for (llvm::GlobalIFunc &I : llvm::make_early_inc_range(M.ifuncs())) {
+    const llvm::Function *resolver = I.getResolverFunction();
+    if (resolver != nullptr && resolver->isDeclaration() && I.use_empty()) {
+      I.eraseFromParent();
+    }
+  }
+  for (llvm::Function &F : llvm::make_early_inc_range(M)) {
+    if (F.isDeclaration() && F.use_empty()) {
+      F.eraseFromParent();
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  // First, so its options can be parsed.
+  llvm::Expected<llvm::PassPlugin> loaded = load_plugin(argc, argv);
+  if (!loaded) {
+    llvm::logAllUnhandledErrors(loaded.takeError(), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "Bounded-termination check on code reachable from roots\n");
+
+  // Headers and function records only; bodies are read on demand, from a
+  // memory-mapped file.
+  llvm::LLVMContext context;
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> M =
+      llvm::getLazyIRFileModule(input_file, diagnostic, context);
+  if (!M) {
+    diagnostic.print(argv[0], llvm::errs());
+    return 1;
+  }
+
+  std::vector<const llvm::Function *> root_functions;
+  for (const std::string &name : roots) {
+    // Only by the mangled name: matching a demangled one would mean
+    // demangling every function in the file.
+    const llvm::Function *F = M->getFunction(name);
+    if (F == nullptr) {
+      llvm::errs() << argv[0] << ": no function named " << name
+                   << " (roots are given by their mangled names)\n";
+      return 1;
+    }
+    root_functions.push_back(F);
+  }
+  const size_t total = M->size();
+  std::vector<llvm::GlobalValue *> candidates;
+  llvm::Expected<size_t> materialized =
+      materialize_reachable(root_functions, whole_program(), candidates);
+  if (!materialized) {
+    llvm::logAllUnhandledErrors(materialized.takeError(), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  // Their address may be taken in code we didn't read.
+  llvm::appendToCompilerUsed(*M, candidates);
+  drop_unreached(*M);
+  if (llvm::Error error = M->materializeMetadata()) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  llvm::errs() << "Read " << *materialized << " of " << total
+               << " function(s)\n\n";
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB;
+  loaded->registerPassBuilderCallbacks(PB);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  if (llvm::Error error = PB.parsePassPipeline(MPM, passes)) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  // Errors (e.g. must-be-bounded violations) exit from the context's
+  // diagnostic handler.
+  MPM.run(*M, MAM);
+  return 0;
+}
@@ -0,0 +1,505 @@
+
+// Checks the code the backend actually produced, not just the IR it started
+// from:
+//
+//   MachineCheck -mtriple=thumbv7em-none-eabi program.ll
+//
+// The termination checker (loaded as a plugin, as with opt) annotates each
+// block with its verdict; then the module goes through instruction
+// selection and the rest of code generation, and a machine-function pass
+// looks at the result. Expanding a memcpy, an atomic (into a load-linked /
+// store-conditional retry loop) or wide arithmetic (into a libcall) can add
+// loops and calls the IR-level analysis never saw. A function that gained
+// any gets them as Unknown, joined with its IR verdict. Functions the backend
+// made (by outlining repeated code) aren't listed; a call into one is new
+// only if the code it holds would be.
+
+#include "DriverPlugin.h"
+#include "Lattice.h"
+#include "Names.h"
+#include "SCCLoopPass.h"
+#include "TerminationLattice.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/MC/MCSymbol.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Host.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Type definitions
+//------------------------------------------------------------------------------
+
+// What the IR-level analysis saw of a function, before code generation.
+struct IRFunction {
+  // FunctionTerminationPass's verdict for the entry block: the function's
+  // own, assuming what it calls is Bounded.
+  std::optional<DoesThisTerminate> elt;
+  // Headers of its loops, nested ones too, and the entries of cycles that
+  // aren't loops. Handles, since code generation's IR passes delete blocks,
+  // and a new one may land at the same address.
+  std::vector<llvm::WeakVH> loop_headers;
+  // Names of everything it calls directly, with the memory intrinsics under
+  // the names of the libcalls they may become.
+  llvm::StringSet<> callees;
+  bool calls_indirectly = false;
+};
+
+// The machine-level verdict for one function.
+struct MachineResult {
+  DoesThisTerminate elt = DoesThisTerminate::Unevaluated;
+  std::optional<DoesThisTerminate> ir_elt;
+  // Loops and calls the backend added, described.
+  std::vector<std::string> gained;
+  uint64_t frame_bytes = 0;
+  uint64_t instructions = 0;
+};
+
+// Runs after the rest of code generation, on each function's final machine
+// code.
+class MachineTerminationCheck : public llvm::MachineFunctionPass {
+public:
+  static char ID;
+
+  MachineTerminationCheck(
+      const llvm::DenseMap<const llvm::Function *, IRFunction> &ir,
+      std::map<std::string, MachineResult> &results)
+      : llvm::MachineFunctionPass(ID), ir(ir), results(results) {}
+
+  llvm::StringRef getPassName() const override {
+    return "Machine-level termination check";
+  }
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.addRequired<llvm::MachineLoopInfo>();
+    AU.setPreservesAll();
+    llvm::MachineFunctionPass::getAnalysisUsage(AU);
+  }
+  bool runOnMachineFunction(llvm::MachineFunction &MF) override;
+
+private:
+  const llvm::DenseMap<const llvm::Function *, IRFunction> &ir;
+  std::map<std::string, MachineResult> &results;
+};
+
+char MachineTerminationCheck::ID = 0;
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    input_file(llvm::cl::Positional, llvm::cl::desc("<input IR or bitcode>"),
+               llvm::cl::Required);
+
+// Read by load_plugin, before parsing; see DriverPlugin.h.
+static llvm::cl::opt<std::string> plugin_path(
+    "load-pass-plugin",
+    llvm::cl::desc("Termination checker plugin (default: "
+                   "BoundedTerminationPass next to this program)"));
+
+static llvm::cl::opt<std::string>
+    target_triple("mtriple",
+                  llvm::cl::desc("Target to generate code for (default: the "
+                                 "module's, or else the host's)"));
+
+static llvm::cl::opt<std::string>
+    target_cpu("mcpu", llvm::cl::desc("CPU to generate code for"));
+
+static llvm::cl::opt<std::string>
+    target_features("mattr", llvm::cl::desc("Target features, e.g. +v7"));
+
+//------------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------------
+
+// Records what the IR-level analysis saw of `F`.
+IRFunction describe(llvm::Function &F) {
+  IRFunction result;
+  result.elt = block_verdict(F.getEntryBlock());
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+  for (const llvm::Loop *loop : LI.getLoopsInPreorder()) {
+    result.loop_headers.emplace_back(loop->getHeader());
+  }
+  llvm::FunctionAnalysisManager unused;
+  const SCCLoopPassResult cycles = SCCLoopPass().run(F, unused);
+  for (uint32_t block : cycles.entry_blocks.set_bits()) {
+    if (!LI.isLoopHeader(cycles.blocks[block])) {
+      result.loop_headers.emplace_back(
+          const_cast<llvm::BasicBlock *>(cycles.blocks[block]));
+    }
+  }
+  for (const llvm::Instruction &I : llvm::instructions(F)) {
+    const auto *call = llvm::dyn_cast<llvm::CallBase>(&I);
+    if (call == nullptr || call->isInlineAsm()) {
+      continue;
+    }
+    const llvm::Function *callee = call->getCalledFunction();
+    if (callee == nullptr) {
+      result.calls_indirectly = true;
+      continue;
+    }
+    result.callees.insert(callee->getName());
+    if (llvm::isa<llvm::MemCpyInst>(call)) {
+      result.callees.insert("memcpy");
+    } else if (llvm::isa<llvm::MemMoveInst>(call)) {
+      result.callees.insert("memmove");
+    } else if (llvm::isa<llvm::MemSetInst>(call)) {
+      result.callees.insert("memset");
+    }
+  }
+  return result;
+}
+
+// A machine block, for people: its number, and the IR block it came from.
+std::string block_name(const llvm::MachineBasicBlock &block) {
+  std::string name = "bb." + std::to_string(block.getNumber());
+  if (const llvm::BasicBlock *BB = block.getBasicBlock();
+      BB != nullptr && BB->hasName()) {
+    name += "." + friendly_name(BB->getName()).str();
+  }
+  return name;
+}
+
+// What `MI` calls, if it names it.
+std::optional<std::string> called_name(const llvm::MachineInstr &MI) {
+  for (const llvm::MachineOperand &operand : MI.operands()) {
+    if (operand.isGlobal()) {
+      return operand.getGlobal()->getName().str();
+    }
+    if (operand.isSymbol()) {
+      return operand.getSymbolName();
+    }
+    if (operand.isMCSymbol()) {
+      return operand.getMCSymbol()->getName().str();
+    }
+  }
+  return std::nullopt;
+}
+
+// Whether the IR-level verdict `before` accounts for `call`: the IR called
+// the same function, or called indirectly for an indirect call. Or it's a
+// call into code the backend split off (MachineOutliner's
+// OUTLINED_FUNCTION_N, with no IR of its own), which is loop-free and only
+// makes calls `before` accounts for. `through` holds the split-off
+// functions we're already inside.
+bool accounted_for(const llvm::MachineInstr &call, const IRFunction &before,
+                   const llvm::DenseMap<const llvm::Function *, IRFunction> &ir,
+                   const llvm::MachineModuleInfo &MMI,
+                   llvm::SmallPtrSetImpl<const llvm::Function *> &through) {
+  const std::optional<std::string> callee = called_name(call);
+  if (!callee) {
+    return before.calls_indirectly;
+  }
+  if (before.callees.contains(*callee)) {
+    return true;
+  }
+  const llvm::Function *F = MMI.getModule()->getFunction(*callee);
+  if (F == nullptr || ir.count(F) || !through.insert(F).second) {
+    return false;
+  }
+  const llvm::MachineFunction *MF = MMI.getMachineFunction(*F);
+  if (MF == nullptr) {
+    return false;
+  }
+  for (auto SCCI = llvm::scc_begin(MF); !SCCI.isAtEnd(); ++SCCI) {
+    if (SCCI.hasCycle()) {
+      return false;
+    }
+  }
+  for (const llvm::MachineBasicBlock &block : *MF) {
+    for (const llvm::MachineInstr &MI : block) {
+      if (MI.isCall() && !accounted_for(MI, before, ir, MMI, through)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Runs the plugin's annotate<bounded-termination> over `M`.
+llvm::Error annotate(llvm::Module &M, llvm::PassPlugin &plugin) {
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB;
+  plugin.registerPassBuilderCallbacks(PB);
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  if (llvm::Error error = PB.parsePassPipeline(
+          MPM, "function(annotate<bounded-termination>)")) {
+    return error;
+  }
+  MPM.run(M, MAM);
+  return llvm::Error::success();
+}
+
+//------------------------------------------------------------------------------
+// Pass bodies
+//------------------------------------------------------------------------------
+
+bool MachineTerminationCheck::runOnMachineFunction(llvm::MachineFunction &MF) {
+  const llvm::Function &F = MF.getFunction();
+  // Code the backend made itself has no IR verdict to compare with; it's
+  // checked where it's called.
+  auto it = ir.find(&F);
+  if (it == ir.end()) {
+    return false;
+  }
+  const IRFunction &before = it->second;
+  MachineResult &result = results[demangled_name(F.getName()).str()];
+  result.ir_elt = before.elt;
+  result.frame_bytes = MF.getFrameInfo().getStackSize();
+
+  // Blocks, densely; the IR loop headers still alive, and the machine block
+  // each IR block got first. Blocks split off later (a pseudo-instruction
+  // expanded into a loop, say) keep pointing at the same IR block, so only
+  // the first one stands for it.
+  llvm::DenseMap<const llvm::MachineBasicBlock *, uint32_t> ordinals;
+  llvm::DenseMap<const llvm::BasicBlock *, const llvm::MachineBasicBlock *>
+      first_for;
+  for (const llvm::MachineBasicBlock &block : MF) {
+    ordinals.insert({&block, ordinals.size()});
+    if (const llvm::BasicBlock *BB = block.getBasicBlock()) {
+      first_for.try_emplace(BB, &block);
+    }
+  }
+  llvm::DenseSet<const llvm::Value *> loop_headers;
+  for (const llvm::WeakVH &handle : before.loop_headers) {
+    if (handle) {
+      loop_headers.insert(handle);
+    }
+  }
+  // Whether `block` heads one of the IR's loops (or enters one of its
+  // cycles), not a loop the backend made.
+  auto from_ir_loop = [&](const llvm::MachineBasicBlock *block) {
+    const llvm::BasicBlock *BB = block->getBasicBlock();
+    return BB != nullptr && loop_headers.contains(BB) &&
+           first_for.lookup(BB) == block;
+  };
+
+  // What the backend added is Unknown; everything else was accounted for
+  // by the IR-level verdict.
+  std::vector<DoesThisTerminate> local(ordinals.size(),
+                                       DoesThisTerminate::Bounded);
+  DenseGraph graph(ordinals.size());
+  for (const llvm::MachineBasicBlock &block : MF) {
+    const uint32_t from = ordinals.lookup(&block);
+    for (const llvm::MachineBasicBlock *successor : block.successors()) {
+      graph.add_edge(from, ordinals.lookup(successor));
+    }
+    for (const llvm::MachineInstr &MI : block) {
+      result.instructions += !MI.isMetaInstruction();
+      if (!MI.isCall()) {
+        continue;
+      }
+      llvm::SmallPtrSet<const llvm::Function *, 4> through;
+      const bool accounted =
+          accounted_for(MI, before, ir, MF.getMMI(), through);
+      if (!accounted) {
+        local[from] = DoesThisTerminate::Unknown;
+        const std::optional<std::string> callee = called_name(MI);
+        result.gained.push_back(
+            (callee ? "a call to " + demangled_name(*callee).str()
+                    : std::string("an indirect call")) +
+            " in " + block_name(block));
+      }
+    }
+  }
+  graph.finish();
+
+  // Loop by loop, nested ones too: a loop inside one of the IR's loops
+  // (an atomic's retry loop, say) is still new.
+  llvm::MachineLoopInfo &MLI = getAnalysis<llvm::MachineLoopInfo>();
+  for (const llvm::MachineLoop *loop : MLI.getBase().getLoopsInPreorder()) {
+    if (from_ir_loop(loop->getHeader())) {
+      continue;
+    }
+    for (const llvm::MachineBasicBlock *block : loop->blocks()) {
+      local[ordinals.lookup(block)] = DoesThisTerminate::Unknown;
+    }
+    result.gained.push_back("a loop at " + block_name(*loop->getHeader()));
+  }
+  // Cycles that aren't loops have no header: one of their blocks has to
+  // enter one of the IR's.
+  for (auto SCCI = llvm::scc_begin(&MF); !SCCI.isAtEnd(); ++SCCI) {
+    if (!SCCI.hasCycle()) {
+      continue;
+    }
+    const llvm::MachineLoop *outermost = MLI.getLoopFor(SCCI->front());
+    while (outermost != nullptr && outermost->getParentLoop() != nullptr) {
+      outermost = outermost->getParentLoop();
+    }
+    if ((outermost != nullptr &&
+         outermost->getNumBlocks() == SCCI->size()) ||
+        llvm::any_of(*SCCI, from_ir_loop)) {
+      continue;
+    }
+    const llvm::MachineBasicBlock *first = SCCI->front();
+    for (const llvm::MachineBasicBlock *block : *SCCI) {
+      local[ordinals.lookup(block)] = DoesThisTerminate::Unknown;
+      if (block->getNumber() < first->getNumber()) {
+        first = block;
+      }
+    }
+    result.gained.push_back("a cycle through " + block_name(*first));
+  }
+
+  const std::vector<DoesThisTerminate> elts =
+      solve_backward<TerminationLattice>(graph, local);
+  const DoesThisTerminate machine =
+      elts.empty() ? DoesThisTerminate::Bounded : elts[0];
+  result.elt = TerminationLattice::join(
+      before.elt.value_or(DoesThisTerminate::Unevaluated), machine);
+  return false;
+}
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  // First, so its options can be parsed.
+  llvm::Expected<llvm::PassPlugin> plugin = load_plugin(argc, argv);
+  if (!plugin) {
+    llvm::logAllUnhandledErrors(plugin.takeError(), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  llvm::PassRegistry &registry = *llvm::PassRegistry::getPassRegistry();
+  llvm::initializeCore(registry);
+  llvm::initializeCodeGen(registry);
+  llvm::initializeLoopStrengthReducePass(registry);
+  llvm::initializeLowerIntrinsicsPass(registry);
+  llvm::initializeUnreachableBlockElimLegacyPassPass(registry);
+  llvm::initializeScalarOpts(registry);
+  llvm::initializeVectorization(registry);
+  llvm::initializeTransformUtils(registry);
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "Bounded-termination check on generated machine code\n");
+
+  llvm::LLVMContext context;
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> M =
+      llvm::parseIRFile(input_file, diagnostic, context);
+  if (!M) {
+    diagnostic.print(argv[0], llvm::errs());
+    return 1;
+  }
+
+  if (llvm::Error error = annotate(*M, *plugin)) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs(),
+                                llvm::Twine(argv[0]) + ": ");
+    return 1;
+  }
+  llvm::DenseMap<const llvm::Function *, IRFunction> ir;
+  for (llvm::Function &F : *M) {
+    if (!F.isDeclaration()) {
+      ir.insert({&F, describe(F)});
+    }
+  }
+
+  std::string triple = target_triple;
+  if (triple.empty()) {
+    triple = M->getTargetTriple();
+  }
+  if (triple.empty()) {
+    triple = llvm::sys::getDefaultTargetTriple();
+  }
+  std::string error;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple, error);
+  if (target == nullptr) {
+    llvm::errs() << argv[0] << ": " << error << "\n";
+    return 1;
+  }
+  std::unique_ptr<llvm::TargetMachine> TM(target->createTargetMachine(
+      triple, target_cpu, target_features, llvm::TargetOptions(),
+      std::nullopt));
+  M->setTargetTriple(triple);
+  M->setDataLayout(TM->createDataLayout());
+  auto &LLVMTM = static_cast<llvm::LLVMTargetMachine &>(*TM);
+
+  // Code generation up to, but not including, printing the assembly; then
+  // the check, while the machine functions are still around.
+  std::map<std::string, MachineResult> results;
+  llvm::legacy::PassManager PM;
+  auto *MMIWP = new llvm::MachineModuleInfoWrapperPass(&LLVMTM);
+  llvm::TargetPassConfig *config = LLVMTM.createPassConfig(PM);
+  PM.add(config);
+  PM.add(MMIWP);
+  if (config->addISelPasses()) {
+    llvm::errs() << argv[0] << ": can't select instructions for " << triple
+                 << "\n";
+    return 1;
+  }
+  config->addMachinePasses();
+  config->setInitialized();
+  PM.add(new MachineTerminationCheck(ir, results));
+  PM.run(*M);
+
+  size_t worse = 0;
+  for (const auto &[name, result] : results) {
+    llvm::outs() << "Function name: " << name << "\n";
+    llvm::outs() << "Result: " << result.elt << "\n";
+    if (result.ir_elt) {
+      llvm::outs() << "IR result: " << *result.ir_elt << "\n";
+    }
+    for (const std::string &gained : result.gained) {
+      llvm::outs() << "Gained: " << gained << "\n";
+    }
+    llvm::outs() << "Machine code: " << result.instructions
+                 << " instruction(s), " << result.frame_bytes
+                 << "-byte frame\n\n";
+    worse += result.ir_elt && *result.ir_elt != result.elt;
+  }
+  llvm::outs() << worse << " function(s) lost their IR-level verdict in "
+               << "code generation\n";
+  return worse == 0 ? 0 : 1;
+}
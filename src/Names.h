@@ -0,0 +1,79 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Demangle/Demangle.h"
+#include <mutex>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Names for people
+//------------------------------------------------------------------------------
+//
+// Demangling a heavily-templated C++ name is slow, and the same few names
+// (callees, loop headers) turn up again and again in explanations and
+// printers. So each distinct name is demangled once, the first time it's
+// printed, and kept for the life of the process.
+//
+// Results point into the cache, and stay valid as long as it does.
+
+class NameCache {
+public:
+  // `llvm::demangle(mangled)`; names that aren't mangled come back as-is.
+  llvm::StringRef demangle(llvm::StringRef mangled) {
+    return lookup(demangled, mangled, [](llvm::StringRef name) {
+      return llvm::demangle(name.str());
+    });
+  }
+
+  // A block or value name, where each '.'-separated part may be mangled
+  // (e.g. "_ZN3foo3barEv.exit"): the parts, demangled, joined with '.'.
+  llvm::StringRef friendly(llvm::StringRef unfriendly) {
+    return lookup(friendly_names, unfriendly, [this](llvm::StringRef name) {
+      std::string result;
+      llvm::StringRef tail = name;
+      while (tail != "") {
+        auto [head, rest] = tail.split('.');
+        tail = rest;
+        result.append(llvm::demangle(head.str()));
+        if (tail != "") {
+          result.push_back('.');
+        }
+      }
+      return result;
+    });
+  }
+
+private:
+  template <typename Compute>
+  llvm::StringRef lookup(llvm::StringMap<std::string> &cache,
+                         llvm::StringRef key, Compute compute) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = cache.try_emplace(key);
+    if (inserted) {
+      it->second = compute(key);
+    }
+    // StringMap entries don't move when the map grows.
+    return it->second;
+  }
+
+  std::mutex mutex;
+  llvm::StringMap<std::string> demangled;
+  llvm::StringMap<std::string> friendly_names;
+};
+
+// The cache shared by every pass in this plugin.
+inline NameCache &name_cache() {
+  static NameCache cache;
+  return cache;
+}
+
+// Demangled name of a function (or any symbol).
+inline llvm::StringRef demangled_name(llvm::StringRef mangled) {
+  return name_cache().demangle(mangled);
+}
+
+// Readable name of a block or value; see NameCache::friendly.
+inline llvm::StringRef friendly_name(llvm::StringRef unfriendly) {
+  return name_cache().friendly(unfriendly);
+}
@@ -1,7 +1,7 @@
 
-#include "llvm/ADT/SCCIterator.h"
+#include "Names.h"
+#include "SCCLoopPass.h"
 #include "llvm/ADT/StringRef.h"
-#include "llvm/Demangle/Demangle.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/LLVMContext.h"
@@ -15,49 +15,10 @@
 #include <string>
 #include <vector>
 
-//------------------------------------------------------------------------------
-// New PM interface
-//------------------------------------------------------------------------------
-
-std::string friendly_name_block(llvm::StringRef unfriendly) {
-  llvm::StringRef tail = unfriendly;
-  llvm::StringRef head;
-  std::string result;
-  while (tail != "") {
-    auto spl = tail.split('.');
-    head = spl.first;
-    tail = spl.second;
-    result.append(llvm::demangle(head));
-    if (tail != "") {
-      result.push_back('.');
-    }
-  }
-
-  return result;
-}
-
-struct SCCLoopPassResult {
-  std::set<llvm::MDNode*> metadata;
-  std::set<std::string> blocks_with_loops;
-};
-
-struct SCCLoopPass : public llvm::AnalysisInfoMixin<SCCLoopPass> {
-  using Result = SCCLoopPassResult;
-  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
-  // Part of the official API:
-  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
-  static bool isRequired() { return true; }
-
-private:
-  // A special type used by analysis passes to provide an address that
-  // identifies that particular analysis pass type.
-  static llvm::AnalysisKey Key;
-  friend struct llvm::AnalysisInfoMixin<SCCLoopPass>;
-};
-
 //------------------------------------------------------------------------------
 // New PM interface for the printer pass
 //------------------------------------------------------------------------------
+// (The analysis itself is in SCCLoopPass.h, for other plugins to share.)
 class SCCLoopPrinter : public llvm::PassInfoMixin<SCCLoopPrinter> {
 public:
   explicit SCCLoopPrinter(llvm::raw_ostream &OutS) : OS(OutS) {}
@@ -71,50 +32,25 @@ private:
   llvm::raw_ostream &OS;
 };
 
-llvm::AnalysisKey SCCLoopPass::Key;
-
-SCCLoopPass::Result SCCLoopPass::run(llvm::Function &F,
-                                     llvm::FunctionAnalysisManager &) {
-  SCCLoopPass::Result result;
-  llvm::SmallVector<std::pair<unsigned int, llvm::MDNode*>> md;
-  F.getAllMetadata(md);
-  for(const auto md : md) {
-    result.metadata.emplace(md.second);
-  }
-
-  for (llvm::scc_iterator<llvm::Function *> it = llvm::scc_begin(&F),
-                                            it_end = llvm::scc_end(&F);
-       it != it_end; ++it) {
-    if (it.hasCycle()) {
-      // Arbitrarily choosing size of 10 as our size for an SCC
-      llvm::SmallPtrSet<llvm::BasicBlock *, 10> basic_blocks(it->begin(),
-                                                             it->end());
-      for (auto block : basic_blocks) {
-        for (const llvm::BasicBlock *pred : llvm::predecessors(block)) {
-          // Check whether pred is not in our basic blocks set
-          if (!basic_blocks.contains(pred)) {
-            result.blocks_with_loops.insert(std::string(block->getName()));
-          }
-        }
-      }
-    }
-  }
-
-  return result;
-}
-
 llvm::PreservedAnalyses
 SCCLoopPrinter::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
   SCCLoopPass::Result &result = FAM.getResult<SCCLoopPass>(F);
-  auto demangled_fn = demangle(F.getName());
+  auto demangled_fn = demangled_name(F.getName());
   OS << demangled_fn << " blocks with loops:\n";
   OS << "\t"
      << "[\n";
-  for (const auto &block_name : result.blocks_with_loops) {
-    OS << "\t" << friendly_name_block(block_name) << ",\n";
+  for (unsigned ordinal : result.entry_blocks.set_bits()) {
+    OS << "\t" << friendly_name(result.blocks[ordinal]->getName()) << ",\n";
   }
   OS << "\t"
      << "]\n";
+  OS << "cycles\n";
+  for (const CFGCycle &cycle : result.cycles) {
+    OS << "\t" << cycle.blocks.size() << " block(s), "
+       << (cycle.irreducible() ? "irreducible, " : "") << "entered "
+       << cycle.entries.size() << " way(s), left " << cycle.exits.size()
+       << " way(s)\n";
+  }
   OS << "metadata\n";
   for(const auto *mdnode : result.metadata) {
     mdnode->print(OS);
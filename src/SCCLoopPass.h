@@ -0,0 +1,152 @@
+#pragma once
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/PassManager.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Cycles in the control-flow graph
+//------------------------------------------------------------------------------
+//
+// The strongly-connected components of a function's CFG that contain a
+// cycle, over dense block ordinals (function order). Unlike LoopInfo, this
+// sees every cycle, including irreducible ones: those entered at more than
+// one block, which have no header and so no Loop.
+//
+// Header-only so that any plugin can register and use it:
+//   FAM.registerPass([&] { return SCCLoopPass(); });
+
+// An edge between blocks, by ordinal.
+struct CFGEdge {
+  // Stands in for `from` on the function's entry block.
+  static constexpr uint32_t kFunctionEntry =
+      std::numeric_limits<uint32_t>::max();
+
+  uint32_t from;
+  uint32_t to;
+};
+
+struct CFGCycle {
+  // Ordinals of the blocks in the cycle, in function order.
+  llvm::SmallVector<uint32_t, 4> blocks;
+  // Edges in from outside the cycle.
+  llvm::SmallVector<CFGEdge, 2> entries;
+  // Edges out of the cycle.
+  llvm::SmallVector<CFGEdge, 2> exits;
+
+  // Entered at more than one block: not a natural loop.
+  bool irreducible() const {
+    for (const CFGEdge &entry : entries) {
+      if (entry.to != entries.front().to) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+struct SCCLoopPassResult {
+  static constexpr uint32_t kNoCycle = std::numeric_limits<uint32_t>::max();
+
+  // Metadata attached to the function.
+  llvm::SmallVector<llvm::MDNode *, 4> metadata;
+  // Blocks by ordinal, and ordinals by block.
+  std::vector<const llvm::BasicBlock *> blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, uint32_t> ordinals;
+  std::vector<CFGCycle> cycles;
+  // For each block, the index of its cycle, or kNoCycle.
+  std::vector<uint32_t> cycle_of;
+  // Blocks in some cycle.
+  llvm::BitVector in_cycle;
+  // Blocks entered from outside their cycle.
+  llvm::BitVector entry_blocks;
+
+  const CFGCycle *cycle_for(const llvm::BasicBlock *block) const {
+    const uint32_t cycle = cycle_of[ordinals.lookup(block)];
+    return cycle == kNoCycle ? nullptr : &cycles[cycle];
+  }
+};
+
+struct SCCLoopPass : public llvm::AnalysisInfoMixin<SCCLoopPass> {
+  using Result = SCCLoopPassResult;
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
+    Result result;
+    llvm::SmallVector<std::pair<unsigned int, llvm::MDNode *>> md;
+    F.getAllMetadata(md);
+    for (const auto &[_, node] : md) {
+      result.metadata.push_back(node);
+    }
+
+    for (const llvm::BasicBlock &block : F) {
+      result.ordinals.insert({&block, result.blocks.size()});
+      result.blocks.push_back(&block);
+    }
+    const size_t size = result.blocks.size();
+    result.cycle_of.assign(size, Result::kNoCycle);
+    result.in_cycle.resize(size);
+    result.entry_blocks.resize(size);
+    if (size == 0) {
+      return result;
+    }
+
+    for (auto it = llvm::scc_begin(&F); !it.isAtEnd(); ++it) {
+      if (!it.hasCycle()) {
+        continue;
+      }
+      const uint32_t cycle = result.cycles.size();
+      CFGCycle &members = result.cycles.emplace_back();
+      for (const llvm::BasicBlock *block : *it) {
+        const uint32_t ordinal = result.ordinals.lookup(block);
+        members.blocks.push_back(ordinal);
+        result.cycle_of[ordinal] = cycle;
+        result.in_cycle.set(ordinal);
+      }
+      llvm::sort(members.blocks);
+    }
+
+    // One walk over the edges finds every cycle's entries and exits.
+    auto enter = [&](uint32_t from, uint32_t to) {
+      result.cycles[result.cycle_of[to]].entries.push_back({from, to});
+      result.entry_blocks.set(to);
+    };
+    if (result.in_cycle.test(0)) {
+      enter(CFGEdge::kFunctionEntry, 0);
+    }
+    for (uint32_t from = 0; from < size; ++from) {
+      const uint32_t from_cycle = result.cycle_of[from];
+      for (const llvm::BasicBlock *successor :
+           llvm::successors(result.blocks[from])) {
+        const uint32_t to = result.ordinals.lookup(successor);
+        const uint32_t to_cycle = result.cycle_of[to];
+        if (from_cycle == to_cycle) {
+          continue;
+        }
+        if (from_cycle != Result::kNoCycle) {
+          result.cycles[from_cycle].exits.push_back({from, to});
+        }
+        if (to_cycle != Result::kNoCycle) {
+          enter(from, to);
+        }
+      }
+    }
+    return result;
+  }
+  // Part of the official API:
+  //  https://llvm.org/docs/WritingAnLLVMNewPMPass.html#required-passes
+  static bool isRequired() { return true; }
+
+private:
+  // A special type used by analysis passes to provide an address that
+  // identifies that particular analysis pass type.
+  inline static llvm::AnalysisKey Key;
+  friend struct llvm::AnalysisInfoMixin<SCCLoopPass>;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "CallGraphPlanes.h"
+#include "Lattice.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/raw_ostream.h"
+#include <optional>
+
+// Key result for the bounded termination pass:
+// Does this X terminate / do we know?
+//
+// The values double as two bits, "some path may terminate" and "some path may
+// not terminate"; see CallGraphPlanes.h.
+enum class DoesThisTerminate {
+  // We haven't evaluated this X yet.
+  // Bottom of the lattice.
+  Unevaluated = 0b00,
+
+  // Definitely terminates in a statically-bounded amount of time.
+  // We assume:
+  // - All memory operations (load/store) complete;
+  //   though this may not be true in all systems (embedded),
+  //   we consider using such transactions in an unbounded context undefined.
+  Bounded = 0b01,
+
+  // The analyzer believes this will not terminate in bounded time:
+  // It diverges, or may extend indefinitely.
+  // For instance, it may read from stdin and wait for a newline-
+  // which may come arbitrarily far in the future, or may never appear.
+  // Or it may attempt to acquire a lock, which may never be released,
+  // or may take arbitrarily long.
+  //
+  // In the current implementation, we assume these things have unbounded
+  // latency:
+  // - System calls
+  // - Some loops (see "unknown")
+  Unbounded = 0b10,
+
+  // The analyzer cannot reason about this X.
+  // This may be because the path is data-flow dependent,
+  // or because the analyzer does not have the reasoning to
+  // bound the flow.
+  //
+  // Functions can be annotated to say "assume yes/no", or "this must be
+  // Bounded": see TerminationAnnotations.
+  //   TODO: The same for a block/call/etc
+  Unknown = 0b11,
+};
+
+// The termination lattice: Unevaluated at the bottom, Unknown at the top,
+// Bounded and Unbounded incomparable in between.
+struct TerminationDomain {
+  using Value = DoesThisTerminate;
+  static constexpr size_t kSize = 4;
+  static constexpr Value kBottom = DoesThisTerminate::Unevaluated;
+
+  static constexpr Value E = DoesThisTerminate::Unevaluated;
+  static constexpr Value B = DoesThisTerminate::Bounded;
+  static constexpr Value U = DoesThisTerminate::Unbounded;
+  static constexpr Value K = DoesThisTerminate::Unknown;
+
+  // Either path may be taken.
+  static constexpr LatticeTable<Value, kSize> kJoin = {{
+      //         E  B  U  K
+      /* E */ {{E, B, U, K}},
+      /* B */ {{B, B, K, K}},
+      /* U */ {{U, K, U, K}},
+      /* K */ {{K, K, K, K}},
+  }};
+
+  // Run this (row), then whatever comes after it (column).
+  // We can only terminate if both parts can; we can diverge if either can.
+  // So a Bounded block ahead of an Unbounded one is Unbounded,
+  // and so is an Unknown one: it is guaranteed not to finish.
+  static constexpr LatticeTable<Value, kSize> kTransfer = {{
+      //         E  B  U  K
+      /* E */ {{E, E, U, U}},
+      /* B */ {{E, B, U, K}},
+      /* U */ {{U, U, U, U}},
+      /* K */ {{U, K, U, K}},
+  }};
+};
+
+using TerminationLattice = TableLattice<TerminationDomain>;
+
+// The bit-plane engine computes the same thing as the tables.
+constexpr bool planes_match_tables() {
+  for (unsigned a = 0; a < TerminationDomain::kSize; ++a) {
+    for (unsigned b = 0; b < TerminationDomain::kSize; ++b) {
+      uint64_t lo = a & kMayTerminate, hi = (a & kMayDiverge) >> 1;
+      transfer_planes(lo, hi, uint64_t(b & kMayTerminate),
+                      uint64_t((b & kMayDiverge) >> 1));
+      const unsigned planes = unsigned(lo | (hi << 1));
+      if (planes != unsigned(TerminationDomain::kTransfer[a][b]) ||
+          (a | b) != unsigned(TerminationDomain::kJoin[a][b])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(planes_match_tables(),
+              "CallGraphPlanes.h disagrees with TerminationDomain");
+
+// Metadata kind for a block's verdict, attached to its terminator by
+// annotate<bounded-termination>, for other plugins (e.g. BlockGraphPass) to
+// read: !{i8 <DoesThisTerminate>}.
+constexpr const char *kTerminationMetadata = "bounded.termination";
+
+inline llvm::StringRef to_string(DoesThisTerminate t) {
+  switch (t) {
+  case DoesThisTerminate::Unevaluated:
+    return "Unevaluated";
+  case DoesThisTerminate::Bounded:
+    return "Bounded";
+  case DoesThisTerminate::Unbounded:
+    return "Unbounded";
+  case DoesThisTerminate::Unknown:
+    return "Unknown";
+  }
+  return "";
+}
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const DoesThisTerminate &dt) {
+  os << to_string(dt);
+  return os;
+}
+
+// The verdict annotate<bounded-termination> left on this block, if any.
+inline std::optional<DoesThisTerminate>
+block_verdict(const llvm::BasicBlock &block) {
+  const llvm::Instruction *terminator = block.getTerminator();
+  if (terminator == nullptr) {
+    return std::nullopt;
+  }
+  const llvm::MDNode *node = terminator->getMetadata(kTerminationMetadata);
+  if (node == nullptr || node->getNumOperands() != 1) {
+    return std::nullopt;
+  }
+  const auto *value =
+      llvm::mdconst::dyn_extract<llvm::ConstantInt>(node->getOperand(0));
+  if (value == nullptr || value->getZExtValue() > 0b11) {
+    return std::nullopt;
+  }
+  return static_cast<DoesThisTerminate>(value->getZExtValue());
+}
@@ -0,0 +1,26 @@
+// step_to's loop only ends if `i` lands on `end`, which depends on its
+// arguments: each call that passes constants is checked on its own.
+
+volatile int ticks;
+
+__attribute__((noinline)) void step_to(unsigned end, unsigned step) {
+    for (unsigned i = 0; i != end; i += step) {
+        ticks++;
+    }
+}
+
+// Bounded: 0, 2, ..., 10.
+void even() {
+    step_to(10, 2);
+}
+
+// Unbounded: stepping by 2 from 0 never reaches 9, even wrapping around.
+void odd() {
+    step_to(9, 2);
+}
+
+int main() {
+    even();
+    odd();
+    return 0;
+}
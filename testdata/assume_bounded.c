@@ -0,0 +1,16 @@
+
+// Vetted by hand: the hardware drains the FIFO within a few cycles,
+// so this loop is bounded even though we can't prove it.
+__attribute__((annotate("assume-bounded"))) void wait_for_fifo(void) {
+    while(*(volatile int *)0x40001000) {}
+}
+
+// The analysis reports an error if this isn't Bounded.
+__attribute__((annotate("must-be-bounded"))) void isr(void) {
+    wait_for_fifo();
+}
+
+int main() {
+    isr();
+    return 0;
+}
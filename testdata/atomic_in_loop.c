@@ -0,0 +1,32 @@
+// For build/MachineCheck, e.g. with -mtriple=aarch64-linux-gnu (no LSE):
+// every function is Bounded in the IR.
+//
+// The atomic increment becomes a load-exclusive / store-exclusive retry
+// loop inside the counted loop, and the 128-bit division a call to
+// __udivti3. Both functions come out Unknown at the machine level; the
+// plain loop in sum stays Bounded.
+
+#include <stdatomic.h>
+
+atomic_int hits;
+
+void count(int n) {
+    for (int i = 0; i < 10 && i < n; i++) {
+        atomic_fetch_add(&hits, 1);
+    }
+}
+
+unsigned __int128 scale(unsigned __int128 x, unsigned __int128 d) {
+    for (int i = 0; i < 4; i++) {
+        x = x / d + 1;
+    }
+    return x;
+}
+
+int sum(const int *values) {
+    int total = 0;
+    for (int i = 0; i < 8; i++) {
+        total += values[i];
+    }
+    return total;
+}
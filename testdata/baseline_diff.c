@@ -0,0 +1,33 @@
+// For save<bounded-termination> and diff<bounded-termination>: save a
+// baseline from this file, then diff baseline_diff_changed.c (the same, with
+// WAIT_FOREVER defined) against it. baseline_diff_g.c and
+// baseline_diff_g_changed.c are the same pair built with -g.
+//
+// wait_ready loses its retry limit, so it and main regress from Bounded to
+// Unknown (a loop that spins until another thread writes). tick hasn't
+// changed and calls nothing that has, so it's pinned to its saved result
+// and not analyzed again. It comes after wait_ready on purpose: with -g,
+// the edit adds metadata ahead of tick's, which must not unpin it.
+
+volatile int ready;
+volatile int ticks;
+
+__attribute__((noinline)) int wait_ready(void) {
+#ifdef WAIT_FOREVER
+    while (!ready) {
+    }
+#else
+    for (int i = 0; i < 100 && !ready; i++) {
+    }
+#endif
+    return ready;
+}
+
+__attribute__((noinline)) void tick(void) {
+    ticks++;
+}
+
+int main() {
+    tick();
+    return wait_ready();
+}
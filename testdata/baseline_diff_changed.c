@@ -0,0 +1,3 @@
+// baseline_diff.c after the edit; see there.
+#define WAIT_FOREVER
+#include "baseline_diff.c"
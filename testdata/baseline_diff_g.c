@@ -0,0 +1,2 @@
+// baseline_diff.c, built with -g (see baseline_diff_g.flags).
+#include "baseline_diff.c"
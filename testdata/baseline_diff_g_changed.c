@@ -0,0 +1,2 @@
+// baseline_diff_changed.c, built with -g (see baseline_diff_g_changed.flags).
+#include "baseline_diff_changed.c"
@@ -0,0 +1,17 @@
+// walk only calls itself while depth > 0, passing depth - 1, so from main
+// it's at most 9 calls deep: Bounded, with a stack bound, rather than
+// Unknown for being recursive.
+
+volatile int visits;
+
+static __attribute__((noinline)) void walk(int depth) {
+    if (depth > 0) {
+        walk(depth - 1);
+        visits++;
+    }
+}
+
+int main() {
+    walk(8);
+    return 0;
+}
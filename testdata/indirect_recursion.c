@@ -0,0 +1,24 @@
+// Run with -bounded-termination-whole-program, so that the call through
+// `next` goes to the address-taken functions of its type (just pong).
+
+void ping(int n);
+void pong(int n);
+
+void (*volatile next)(int) = pong;
+
+// ping calls pong through a pointer, and pong calls ping back: recursion the
+// direct call graph doesn't see. Both are Unknown, not Bounded.
+void ping(int n) {
+    if (n > 0) {
+        next(n - 1);
+    }
+}
+
+void pong(int n) {
+    ping(n);
+}
+
+int main() {
+    ping(3);
+    return 0;
+}
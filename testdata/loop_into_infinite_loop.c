@@ -0,0 +1,24 @@
+// Run with -bounded-termination-attributes=verify: clang marks
+// drain_then_park noreturn, which is otherwise taken as its verdict.
+//
+// The loop on n would be argument-bounded, but its only way out leads into
+// a loop with no exit. Neither can reach a return, so both are labelled
+// Unbounded before any loop is classified, and no argument-bounded summary
+// is recorded for the first. drain_then_park and main are Unbounded.
+
+volatile int pending;
+volatile int parked;
+
+__attribute__((noinline)) void drain_then_park(int n) {
+    for (int i = 0; i < n; i++) {
+        pending--;
+    }
+    for (;;) {
+        parked++;
+    }
+}
+
+int main() {
+    drain_then_park(4);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include <atomic>
+
+// Both loops below are bounded if no other thread touches the location,
+// and unbounded if one keeps winning.
+
+static std::atomic<bool> lock_taken = false;
+static std::atomic<int> counter = 1;
+
+void acquire() {
+    while(lock_taken.exchange(true, std::memory_order_acquire)) {}
+}
+
+void release() {
+    lock_taken.store(false, std::memory_order_release);
+}
+
+void double_counter() {
+    int expected = counter.load();
+    while(!counter.compare_exchange_weak(expected, expected * 2)) {}
+}
+
+int main() {
+    acquire();
+    double_counter();
+    release();
+    return counter.load();
+}